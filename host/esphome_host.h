@@ -0,0 +1,37 @@
+#pragma once
+
+// Minimal environment to build the remote_base decoders on a Linux host, outside of ESPHome.
+// Compile with -DUSE_REMOTE_BASE_HOST -Ihost -Iremote_base.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+
+namespace esphome {
+
+template<typename T> using optional = std::optional<T>;
+
+inline uint32_t micros() {
+  return uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+}
+
+inline uint32_t millis() {
+  return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+}
+
+}  // namespace esphome
+
+#define IRAM_ATTR
+
+// the decoders log nothing on the host
+#define ESP_LOGE(tag, ...) ((void) 0)
+#define ESP_LOGW(tag, ...) ((void) 0)
+#define ESP_LOGI(tag, ...) ((void) 0)
+#define ESP_LOGD(tag, ...) ((void) 0)
+#define ESP_LOGV(tag, ...) ((void) 0)
+#define ESP_LOGVV(tag, ...) ((void) 0)
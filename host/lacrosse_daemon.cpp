@@ -0,0 +1,431 @@
+// Lacrosse decoder daemon: decodes on a Linux host the raw captures streamed by many receivers.
+//
+// Each stream (file, FIFO, stdin or TCP connection) carries one frame per line, in the
+// RemoteReceiveData format: signed durations in us (mark > 0, space < 0) separated by spaces or
+// commas, optionally preceded by the reception time in ms and a colon:
+//
+//   123456: 500, -1100, 1300, -1000, ...
+//
+// The streams are decoded in parallel on a work stealing thread pool, each with its own LacrosseState.
+// The batches of a stream are decoded one at a time and in order, so its readings come out in the order
+// its frames were read, while a slow or stalled stream does not hold back the output of the others.
+//
+// At the end, the latency histograms of the streams are printed on stderr: capture (first edge, estimated
+// from the durations, to the line read), queue (line read to decode start), decode, dedupe and publish
+// (decode end to the output written).
+//
+// Build, from the repository root:
+//
+//   g++ -std=gnu++17 -O2 -DUSE_REMOTE_BASE_HOST -Ihost -Iremote_base host/lacrosse_daemon.cpp
+//       remote_base/lacrosse_protocol.cpp remote_base/lacrosse_scheduler.cpp remote_base/lacrosse_history.cpp
+//       -pthread -o lacrosse_daemon
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "lacrosse_protocol.h"
+#include "lacrosse_synthetic.h"
+#include "work_stealing_pool.h"
+
+using namespace esphome;
+using namespace esphome::remote_base;
+
+static const size_t BATCH_FRAMES = 256;
+static const size_t READ_CHUNK = 64 * 1024;
+
+struct Frame {
+  uint32_t timestamp_ms;
+  std::vector<int32_t> data;
+  RemoteReceiveTimestamps timestamps{};
+};
+
+/// The frame closes now, as in RemoteReceiverBase: its first edge is estimated from its durations
+static void stamp_frame(Frame &frame) {
+  uint32_t duration_us = 0;
+  for (int32_t pulse : frame.data)
+    duration_us += std::abs(pulse);
+  frame.timestamps.frame_close_us = micros();
+  frame.timestamps.first_edge_us = frame.timestamps.frame_close_us - duration_us;
+}
+
+struct Batch {
+  std::vector<Frame> frames;
+};
+
+struct Stream {
+  std::string name;
+  int fd{-1};
+  std::string partial;  // line not complete yet
+  uint32_t frames{0};
+  LacrosseState state{};
+
+  std::mutex mutex;
+  std::deque<Batch> batches;
+  bool scheduled{false};
+};
+
+/// Writes the output of each batch as soon as it is decoded: the order is kept within each stream only
+class StreamSink {
+ public:
+  explicit StreamSink(bool quiet) : quiet_(quiet) {}
+
+  void push(std::string &&output) {
+    if (this->quiet_ || output.empty())
+      return;
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    fwrite(output.data(), 1, output.size(), stdout);
+    fflush(stdout);  // a batch at a time, to the collector reading the pipe
+  }
+
+ protected:
+  std::mutex mutex_;
+  bool quiet_;
+};
+
+struct Options {
+  uint8_t tolerance{35};
+  unsigned workers{0};
+  bool binary{false};
+  bool quiet{false};
+  uint32_t synthetic_streams{0};
+  uint32_t synthetic_frames{0};
+};
+
+static Options options;
+static std::atomic<uint64_t> total_frames{0};
+static std::atomic<uint64_t> total_readings{0};
+
+static void append_reading(std::string &out, const Stream &stream, const Frame &frame, const LacrosseData &data) {
+  if (options.binary) {
+    uint8_t record[LACROSSE_RECORD_SIZE];
+    for (uint8_t i = 0; i < data.iMeasures && i < LACROSSE_MEASURES_MAX; i++) {
+      const LacrosseMeasure &measure = data.measures[i];
+      lacrosse_record_encode(LacrosseRecord{measure.family, measure.address, measure.type, measure.quantity,
+                                            data.quality, lacrosse_fixed_point(measure.value, 100), frame.timestamp_ms},
+                             record);
+      out.append(reinterpret_cast<const char *>(record), sizeof(record));
+    }
+    return;
+  }
+  char line[160];
+  int len = data.cached ? snprintf(line, sizeof(line), "%s %u %s cached\n", stream.name.c_str(),
+                                   frame.timestamp_ms, data.buf)
+                        : snprintf(line, sizeof(line), "%s %u %s q=%u\n", stream.name.c_str(), frame.timestamp_ms,
+                                   data.buf, data.quality);
+  out.append(line, std::min<size_t>(len, sizeof(line) - 1));
+}
+
+/// Decodes the queued batches of a stream, one task at a time per stream
+static void decode_stream(Stream *stream, StreamSink *sink) {
+  while (true) {
+    Batch batch;
+    {
+      std::lock_guard<std::mutex> lock(stream->mutex);
+      if (stream->batches.empty()) {
+        stream->scheduled = false;
+        return;
+      }
+      batch = std::move(stream->batches.front());
+      stream->batches.pop_front();
+    }
+    std::string out;
+    std::vector<LacrosseData> readings;
+    for (Frame &frame : batch.frames) {
+      LacrosseProtocol protocol(&stream->state);
+      auto res = protocol.decode(RemoteReceiveData(&frame.data, options.tolerance, &frame.timestamps),
+                                 frame.timestamp_ms);
+      if (res.has_value()) {
+        append_reading(out, *stream, frame, *res);
+        readings.push_back(*res);
+      }
+    }
+    total_frames += batch.frames.size();
+    total_readings += readings.size();
+    sink->push(std::move(out));
+    const uint32_t now_us = micros();
+    for (const LacrosseData &reading : readings)
+      stream->state.latency.record_publish(reading.family, reading.address, now_us);
+  }
+}
+
+static void submit_batch(WorkStealingPool &pool, StreamSink &sink, Stream *stream, Batch &&batch) {
+  std::lock_guard<std::mutex> lock(stream->mutex);
+  stream->batches.push_back(std::move(batch));
+  if (!stream->scheduled) {
+    stream->scheduled = true;
+    pool.submit([stream, &sink] { decode_stream(stream, &sink); });
+  }
+}
+
+/// Parses a line into a frame, false for the empty and comment lines
+static bool parse_frame(Stream &stream, const char *begin, const char *end, Frame *frame) {
+  frame->data.clear();
+  frame->timestamp_ms = stream.frames * 1000;  // no timestamp: one frame per second
+  const char *p = begin;
+  while (p < end) {
+    if (*p == '#')
+      break;
+    if (*p == '-' || (*p >= '0' && *p <= '9')) {
+      char *next;
+      const long value = strtol(p, &next, 10);
+      if (next < end && *next == ':' && frame->data.empty()) {
+        frame->timestamp_ms = uint32_t(value);
+      } else {
+        frame->data.push_back(int32_t(value));
+      }
+      p = next;
+      continue;
+    }
+    p++;
+  }
+  if (frame->data.empty())
+    return false;
+  stream.frames++;
+  stamp_frame(*frame);
+  return true;
+}
+
+/// Reads what is available on the stream, false at the end of the stream
+static bool read_stream(WorkStealingPool &pool, StreamSink &sink, Stream *stream) {
+  char chunk[READ_CHUNK];
+  const ssize_t len = read(stream->fd, chunk, sizeof(chunk));
+  if (len < 0 && (errno == EAGAIN || errno == EINTR))
+    return true;
+  if (len <= 0) {
+    if (!stream->partial.empty())
+      stream->partial.push_back('\n');  // last line without end of line
+    else
+      return false;
+  } else {
+    stream->partial.append(chunk, len);
+  }
+
+  Batch batch;
+  size_t start = 0;
+  size_t eol;
+  while ((eol = stream->partial.find('\n', start)) != std::string::npos) {
+    Frame frame;
+    if (parse_frame(*stream, stream->partial.data() + start, stream->partial.data() + eol, &frame))
+      batch.frames.push_back(std::move(frame));
+    start = eol + 1;
+    if (batch.frames.size() == BATCH_FRAMES) {
+      submit_batch(pool, sink, stream, std::move(batch));
+      batch = Batch{};
+    }
+  }
+  stream->partial.erase(0, start);
+  if (!batch.frames.empty())
+    submit_batch(pool, sink, stream, std::move(batch));
+  return len > 0;
+}
+
+static void print_latency(const std::vector<std::unique_ptr<Stream>> &streams) {
+  LacrosseLatency total;
+  for (const auto &stream : streams) {
+    const LacrosseLatency &latency = stream->state.latency;
+    total.capture.merge(latency.capture);
+    total.queue.merge(latency.queue);
+    total.decode.merge(latency.decode);
+    total.dedupe.merge(latency.dedupe);
+    total.publish.merge(latency.publish);
+  }
+  fprintf(stderr, "latency (us)      count       mean        p50        p95        max\n");
+  const std::pair<const char *, const LatencyHistogram *> stages[] = {
+      {"capture", &total.capture}, {"queue", &total.queue},     {"decode", &total.decode},
+      {"dedupe", &total.dedupe},   {"publish", &total.publish},
+  };
+  for (const auto &stage : stages) {
+    const LatencyHistogram &histogram = *stage.second;
+    fprintf(stderr, "%-12s %10u %10u %10u %10u %10u\n", stage.first, histogram.get_count(), histogram.get_mean(),
+            histogram.percentile(50), histogram.percentile(95), histogram.get_max());
+  }
+}
+
+static int listen_tcp(uint16_t port) {
+  const int fd = socket(AF_INET6, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  const int yes = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  sockaddr_in6 addr{};
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_any;
+  addr.sin6_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int run_streams(WorkStealingPool &pool, StreamSink &sink, const std::vector<std::string> &sources) {
+  std::vector<std::unique_ptr<Stream>> streams;
+  std::vector<int> listeners;
+  for (const std::string &source : sources) {
+    if (source.rfind("tcp:", 0) == 0) {
+      const int fd = listen_tcp(uint16_t(atoi(source.c_str() + 4)));
+      if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", source.c_str(), strerror(errno));
+        return 1;
+      }
+      listeners.push_back(fd);
+      continue;
+    }
+    const int fd = source == "-" ? STDIN_FILENO : open(source.c_str(), O_RDONLY);
+    if (fd < 0) {
+      fprintf(stderr, "%s: %s\n", source.c_str(), strerror(errno));
+      return 1;
+    }
+    streams.emplace_back(new Stream());
+    streams.back()->name = source;
+    streams.back()->fd = fd;
+  }
+
+  std::vector<Stream *> open_streams;
+  for (auto &stream : streams)
+    open_streams.push_back(stream.get());
+  while (!open_streams.empty() || !listeners.empty()) {
+    std::vector<pollfd> fds;
+    for (int fd : listeners)
+      fds.push_back(pollfd{fd, POLLIN, 0});
+    for (Stream *stream : open_streams)
+      fds.push_back(pollfd{stream->fd, POLLIN, 0});
+    if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR)
+      break;
+
+    for (size_t i = 0; i < listeners.size(); i++) {
+      if (!(fds[i].revents & POLLIN))
+        continue;
+      const int fd = accept(listeners[i], nullptr, nullptr);
+      if (fd < 0)
+        continue;
+      streams.emplace_back(new Stream());
+      streams.back()->name = "tcp#" + std::to_string(fd);
+      streams.back()->fd = fd;
+      open_streams.push_back(streams.back().get());
+    }
+    std::vector<Stream *> still_open;
+    for (size_t i = 0; i < open_streams.size(); i++) {
+      Stream *stream = open_streams[i];
+      const short revents = i + listeners.size() < fds.size() ? fds[i + listeners.size()].revents : 0;
+      if (revents == 0 || read_stream(pool, sink, stream)) {
+        still_open.push_back(stream);
+      } else if (stream->fd != STDIN_FILENO) {
+        close(stream->fd);
+      }
+    }
+    open_streams.swap(still_open);
+  }
+  pool.wait();
+  print_latency(streams);
+  return 0;
+}
+
+/// Synthetic load: TX3 sensors spread over the streams, the frames generated before the timing
+static int run_synthetic(WorkStealingPool &pool, StreamSink &sink) {
+  std::vector<std::unique_ptr<Stream>> streams;
+  std::vector<std::vector<Batch>> batches(options.synthetic_streams);
+  for (uint32_t s = 0; s < options.synthetic_streams; s++) {
+    streams.emplace_back(new Stream());
+    streams.back()->name = "synthetic#" + std::to_string(s);
+    LacrosseSynthetic synthetic(s + 1);
+    Batch batch;
+    for (uint32_t f = 0; f < options.synthetic_frames; f++) {
+      const uint8_t address = uint8_t((s * 7 + f % 8) & 0x7F);
+      const float value = 15.0f + float(f % 100) / 10;
+      if (f % 4 == 3) {  // one frame in four from a WS7000 sensor, types 2 to 5
+        const uint8_t digits[] = {uint8_t(f % 10), 1, 2, 0, 5, 4, 3, 0, 1, 0};
+        batch.frames.push_back(Frame{f * 1000, synthetic.ws7000(address & 0x07, uint8_t(2 + f / 4 % 4),
+                                                                {std::begin(digits), std::end(digits)}, 80)});
+      } else {
+        batch.frames.push_back(Frame{f * 1000, synthetic.tx3(address, f % 2 ? 0xE : 0x0, value, 120)});
+      }
+      if (batch.frames.size() == BATCH_FRAMES || f + 1 == options.synthetic_frames) {
+        batches[s].push_back(std::move(batch));
+        batch = Batch{};
+      }
+    }
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t s = 0; s < options.synthetic_streams; s++) {
+    for (Batch &batch : batches[s]) {
+      for (Frame &frame : batch.frames)
+        stamp_frame(frame);
+      submit_batch(pool, sink, streams[s].get(), std::move(batch));
+    }
+  }
+  pool.wait();
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%u workers: %.0f frames/s\n", pool.size(), total_frames / seconds);
+  print_latency(streams);
+  return 0;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-j workers] [-t tolerance] [-b] [-q] STREAM...\n"
+          "       %s [-j workers] --synthetic STREAMS:FRAMES\n"
+          "  STREAM  file, FIFO, '-' for stdin or tcp:PORT to accept connections\n"
+          "  -b      binary telemetry records on stdout instead of text\n"
+          "  -q      no output, statistics only\n",
+          name, name);
+}
+
+int main(int argc, char **argv) {
+  std::vector<std::string> sources;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      options.workers = atoi(argv[++i]);
+    } else if (arg == "-t" && i + 1 < argc) {
+      options.tolerance = uint8_t(atoi(argv[++i]));
+    } else if (arg == "-b") {
+      options.binary = true;
+    } else if (arg == "-q") {
+      options.quiet = true;
+    } else if (arg == "--synthetic" && i + 1 < argc) {
+      if (sscanf(argv[++i], "%u:%u", &options.synthetic_streams, &options.synthetic_frames) != 2) {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (arg == "-h" || arg == "--help" || (arg[0] == '-' && arg.size() > 1)) {
+      usage(argv[0]);
+      return 2;
+    } else {
+      sources.push_back(arg);
+    }
+  }
+  if (sources.empty() && options.synthetic_streams == 0) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  int ret;
+  {
+    WorkStealingPool pool(options.workers != 0 ? options.workers : std::thread::hardware_concurrency());
+    StreamSink sink(options.quiet || options.synthetic_streams > 0);
+    ret = options.synthetic_streams > 0 ? run_synthetic(pool, sink) : run_streams(pool, sink, sources);
+    fflush(stdout);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%llu frames, %llu readings in %.3f s, %llu steals\n", (unsigned long long) total_frames,
+            (unsigned long long) total_readings, seconds, (unsigned long long) pool.get_steals());
+  }
+  return ret;
+}
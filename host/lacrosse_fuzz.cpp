@@ -0,0 +1,206 @@
+// Coverage guided fuzz target of LacrosseProtocol::decode and RemoteReceiveData.
+//
+// Input: one byte of tolerance (per cent, modulo 100) then the pulses, 2 bytes little endian each:
+// bit 15 set for a space, bits 0..14 the duration in us. The frame is decoded twice, 61 s apart, with
+// a fresh LacrosseState, to go through the deduplication and the schedule learning.
+//
+// A decode using more CPU time than the budget (LACROSSE_FUZZ_BUDGET_US, 2000 us by default) aborts
+// like a crash: a slow decode makes the receiver miss the next frame. The input is capped at the size
+// of the receiver buffer, so the budget bounds the worst case of a real frame.
+//
+// libFuzzer build, from the repository root:
+//
+//   clang++ -std=gnu++17 -g -O1 -fsanitize=fuzzer,address,undefined -D_GLIBCXX_ASSERTIONS
+//       -DUSE_REMOTE_BASE_HOST -Ihost -Iremote_base host/lacrosse_fuzz.cpp
+//       remote_base/lacrosse_protocol.cpp remote_base/lacrosse_scheduler.cpp remote_base/lacrosse_history.cpp
+//       -o lacrosse_fuzz
+//   ./lacrosse_fuzz -max_len=5121 corpus/
+//
+// Without libFuzzer, -DLACROSSE_FUZZ_STANDALONE builds a driver that writes the seed corpus and
+// replays inputs:
+//
+//   lacrosse_fuzz --seeds corpus/ [CAPTURE...]   synthetic frames, and the frames of the captures
+//                                                (lines of the lacrosse_daemon format)
+//   lacrosse_fuzz INPUT...                       replays the inputs, prints the slowest decode
+
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "lacrosse_protocol.h"
+#include "lacrosse_synthetic.h"
+
+using namespace esphome;
+using namespace esphome::remote_base;
+
+static const size_t FUZZ_PULSES_MAX = 2560;  // 10 kB receiver buffer
+static const uint16_t FUZZ_SPACE_BIT = 0x8000;
+
+static uint32_t fuzz_budget_us() {
+  static const uint32_t budget = [] {
+    const char *env = getenv("LACROSSE_FUZZ_BUDGET_US");
+    return env != nullptr ? uint32_t(strtoul(env, nullptr, 10)) : 2000u;
+  }();
+  return budget;
+}
+
+// CPU time of the thread: the budget is not spent while the process is preempted
+static uint64_t thread_cpu_ns() {
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return uint64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+/// CPU time of the slowest of the two decodes of the frame, first reading decoded in first
+static uint32_t decode_us(std::vector<int32_t> &raw, uint8_t tolerance, optional<LacrosseData> *first = nullptr) {
+  LacrosseState state{};
+  LacrosseProtocol protocol(&state);
+  uint32_t slowest_us = 0;
+  for (uint32_t now_ms : {1000u, 62000u}) {
+    const uint64_t start_ns = thread_cpu_ns();
+    const optional<LacrosseData> res = protocol.decode(RemoteReceiveData(&raw, tolerance), now_ms);
+    slowest_us = std::max<uint32_t>(slowest_us, (thread_cpu_ns() - start_ns) / 1000);
+    if (first != nullptr && now_ms == 1000u)
+      *first = res;
+  }
+  return slowest_us;
+}
+
+static uint32_t fuzz_decode(const uint8_t *data, size_t size) {
+  if (size < 1)
+    return 0;
+  const uint8_t tolerance = data[0] % 100;
+  const size_t pulses = std::min((size - 1) / 2, FUZZ_PULSES_MAX);
+  std::vector<int32_t> raw(pulses);  // exact size: reads past the end are caught by the sanitizers
+  for (size_t i = 0; i < pulses; i++) {
+    const uint16_t word = data[1 + 2 * i] | uint16_t(data[2 + 2 * i]) << 8;
+    const int32_t duration = word & ~FUZZ_SPACE_BIT;
+    raw[i] = word & FUZZ_SPACE_BIT ? -duration : duration;
+  }
+
+  uint32_t elapsed_us = decode_us(raw, tolerance);
+  if (elapsed_us > fuzz_budget_us())  // once more: page faults and interrupts are charged to the thread too
+    elapsed_us = std::min(elapsed_us, decode_us(raw, tolerance));
+  if (elapsed_us > fuzz_budget_us()) {
+    fprintf(stderr, "decode of %zu pulses took %u us, budget %u us\n", pulses, elapsed_us, fuzz_budget_us());
+    abort();
+  }
+  return elapsed_us;
+}
+
+extern "C" int LLVMFuzzerInitialize(int * /*argc*/, char *** /*argv*/) {
+  LacrosseProtocol::telemetry().set_writer([](const uint8_t * /*data*/, size_t /*len*/) {});  // cover the records
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzz_decode(data, size);
+  return 0;
+}
+
+#ifdef LACROSSE_FUZZ_STANDALONE
+
+static std::vector<uint8_t> fuzz_input(const std::vector<int32_t> &raw, uint8_t tolerance) {
+  std::vector<uint8_t> input{tolerance};
+  for (int32_t duration : raw) {
+    const uint16_t word = std::min<uint32_t>(std::abs(duration), ~FUZZ_SPACE_BIT & 0xFFFF) |
+                          (duration < 0 ? FUZZ_SPACE_BIT : 0);
+    input.push_back(word);
+    input.push_back(word >> 8);
+  }
+  return input;
+}
+
+static bool write_file(const std::string &path, const std::vector<uint8_t> &content) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    perror(path.c_str());
+    return false;
+  }
+  fwrite(content.data(), 1, content.size(), file);
+  fclose(file);
+  return true;
+}
+
+static uint32_t write_seeds(const std::string &dir, int argc, char **argv) {
+  LacrosseSynthetic synthetic(7);
+  uint32_t count = 0;
+  auto seed = [&](const std::vector<int32_t> &raw) {
+    if (write_file(dir + "/seed-" + std::to_string(count), fuzz_input(raw, 35)))
+      count++;
+  };
+  // the synthetic seeds must reach the end of the decoder: a seed rejected early covers only the preamble
+  auto decoded_seed = [&](std::vector<int32_t> raw, bool decodes) {
+    optional<LacrosseData> first;
+    decode_us(raw, 35, &first);
+    if (first.has_value() != decodes)
+      fprintf(stderr, "seed-%u: %s\n", count, decodes ? "does not decode" : "decodes, unexpected");
+    seed(raw);
+  };
+
+  for (int32_t jitter : {0, 120}) {  // 150 us is past the tolerance of the shortest pulses
+    decoded_seed(synthetic.tx3(0x73, 0x0, 21.5f, jitter), true);
+    decoded_seed(synthetic.tx3(0x12, 0xE, 48.0f, jitter), true);
+    decoded_seed(synthetic.tx3(0x7F, 0x3, 0.0f, jitter), false);  // unsupported type
+    for (uint8_t type = 0; type < 8; type++)                      // known types and a few unknown ones
+      decoded_seed(synthetic.ws7000(3, type, {1, 2, 3, 4, 5, 6, 7, 8, 9, 1}, jitter),
+                   type >= 2 && type <= 5);  // types 0 and 1 pass the checks but have no measure decoded yet
+  }
+  std::vector<int32_t> collision = synthetic.tx3(0x21, 0x0, 18.0f, 50);
+  const std::vector<int32_t> ws = synthetic.ws7000(2, 4, {5, 1, 2, 0, 5, 4, 3, 0, 1, 0}, 50);
+  collision.insert(collision.begin() + 24, ws.begin(), ws.end());
+  decoded_seed(collision, true);  // the WS7000 frame is found inside the broken TX3 one
+
+  for (int iArg = 0; iArg < argc; iArg++) {  // captures: "[ts:] d, d, ..." per line
+    FILE *file = fopen(argv[iArg], "r");
+    if (file == nullptr) {
+      perror(argv[iArg]);
+      continue;
+    }
+    char line[32 * 1024];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+      const char *cursor = strchr(line, ':');
+      cursor = cursor != nullptr ? cursor + 1 : line;
+      std::vector<int32_t> raw;
+      char *end;
+      for (long value = strtol(cursor, &end, 10); end != cursor; value = strtol(cursor, &end, 10)) {
+        raw.push_back(value);
+        cursor = end + strspn(end, ", \t");
+      }
+      if (!raw.empty())
+        seed(raw);
+    }
+    fclose(file);
+  }
+  return count;
+}
+
+int main(int argc, char **argv) {
+  LLVMFuzzerInitialize(&argc, &argv);
+  if (argc >= 3 && strcmp(argv[1], "--seeds") == 0) {
+    printf("%u seeds written\n", write_seeds(argv[2], argc - 3, argv + 3));
+    return 0;
+  }
+  uint32_t slowest_us = 0;
+  for (int iArg = 1; iArg < argc; iArg++) {
+    FILE *file = fopen(argv[iArg], "rb");
+    if (file == nullptr) {
+      perror(argv[iArg]);
+      return 1;
+    }
+    std::vector<uint8_t> input;
+    uint8_t chunk[4096];
+    for (size_t len; (len = fread(chunk, 1, sizeof(chunk), file)) > 0;)
+      input.insert(input.end(), chunk, chunk + len);
+    fclose(file);
+    slowest_us = std::max(slowest_us, fuzz_decode(input.data(), input.size()));
+  }
+  printf("%d inputs, slowest decode %u us\n", argc - 1, slowest_us);
+  return 0;
+}
+
+#endif  // LACROSSE_FUZZ_STANDALONE
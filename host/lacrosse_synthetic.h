@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace esphome {
+namespace remote_base {
+
+// Synthetic Lacrosse captures, in the RemoteReceiveData format (mark > 0, space < 0), for the host
+// load tests and the fuzzing seeds. jitter_us spreads the pulses widths uniformly.
+
+class LacrosseSynthetic {
+ public:
+  explicit LacrosseSynthetic(uint32_t seed = 1) : seed_(seed) {}
+
+  /// TX3 frame of a temperature (type 0) or humidity (type 0xE) sensor
+  std::vector<int32_t> tx3(uint8_t address, uint8_t type, float value, int32_t jitter_us = 0) {
+    const uint16_t tenths = uint16_t((type == 0 ? value + 50 : value) * 10 + 0.5f);
+    const uint8_t digits[5] = {uint8_t(tenths / 100 % 10), uint8_t(tenths / 10 % 10), uint8_t(tenths % 10),
+                               uint8_t(tenths / 100 % 10), uint8_t(tenths / 10 % 10)};
+    std::vector<uint8_t> nibbles = {0x0, 0xA, type, uint8_t(address >> 3), uint8_t((address & 0x7) << 1)};
+    uint8_t sum = 0;
+    for (uint8_t nibble : nibbles)
+      sum += nibble;
+    for (uint8_t digit : digits) {
+      nibbles.push_back(digit);
+      sum += digit;
+    }
+    nibbles.push_back(sum & 0xF);
+
+    std::vector<int32_t> data;
+    for (uint8_t nibble : nibbles) {
+      for (int8_t bit = 3; bit >= 0; bit--) {  // most significant bit first
+        const bool one = (nibble >> bit) & 1;
+        this->item_(data, one ? 500 : 1300, one ? 1100 : 1000, jitter_us);
+      }
+    }
+    data.back() = -20000;  // gap after the frame
+    return data;
+  }
+
+  /// Digits of a WS7000 frame of the type, 0 when the decoder does not know the type
+  static uint8_t ws7000_digits(uint8_t type) {
+    static const uint8_t counts[] = {3, 6, 3, 6, 10, 7};
+    return type < sizeof(counts) ? counts[type] : 0;
+  }
+
+  /// WS7000 frame: type, address then the digits (least significant bit first), XOR and sum.
+  /// The digits are cut or padded with 0 to the count of the known types.
+  std::vector<int32_t> ws7000(uint8_t address, uint8_t type, std::vector<uint8_t> digits, int32_t jitter_us = 0) {
+    if (ws7000_digits(type) != 0)
+      digits.resize(ws7000_digits(type));
+    std::vector<int32_t> data;
+    for (uint8_t i = 0; i < 10; i++)  // preamble: 10 x 0
+      this->item_(data, 800, 400, jitter_us);
+    std::vector<uint8_t> nibbles = {type, address};
+    nibbles.insert(nibbles.end(), digits.begin(), digits.end());
+    uint8_t check_xor = 0;
+    uint8_t check_sum = 5;
+    for (uint8_t nibble : nibbles) {
+      check_xor ^= nibble;
+      check_sum += nibble;
+    }
+    nibbles.push_back(check_xor);
+    nibbles.push_back((check_sum + check_xor) & 0xF);
+    for (uint8_t nibble : nibbles) {
+      this->item_(data, 400, 800, jitter_us);  // start bit: 1
+      for (uint8_t bit = 0; bit < 4; bit++) {
+        const bool one = (nibble >> bit) & 1;
+        this->item_(data, one ? 400 : 800, one ? 800 : 400, jitter_us);
+      }
+    }
+    data.push_back(-20000);  // gap after the frame: the decoder needs the space of the last bit
+    return data;
+  }
+
+ protected:
+  void item_(std::vector<int32_t> &data, int32_t mark_us, int32_t space_us, int32_t jitter_us) {
+    data.push_back(mark_us + this->jitter_(jitter_us));
+    data.push_back(-(space_us + this->jitter_(jitter_us)));
+  }
+
+  int32_t jitter_(int32_t jitter_us) {
+    if (jitter_us == 0)
+      return 0;
+    this->seed_ = this->seed_ * 1103515245u + 12345u;
+    return int32_t((this->seed_ >> 8) % uint32_t(2 * jitter_us + 1)) - jitter_us;
+  }
+
+  uint32_t seed_;
+};
+
+}  // namespace remote_base
+}  // namespace esphome
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../remote_base/lacrosse_telemetry.h"
+
+namespace esphome {
+namespace remote_base {
+
+/// Read only view of a record inside the received bytes, fields decoded on access (no copy)
+class LacrosseRecordView {
+ public:
+  explicit LacrosseRecordView(const uint8_t *data) : data_(data) {}
+
+  uint8_t family() const { return this->data_[1]; }
+  uint8_t address() const { return this->data_[2]; }
+  uint8_t type() const { return this->data_[3]; }
+  char quantity() const { return char(this->data_[4]); }
+  uint8_t quality() const { return this->data_[5]; }
+  int32_t value_centi() const { return int32_t(this->u32_(6)); }
+  float value() const { return this->value_centi() / 100.0f; }
+  uint32_t timestamp_ms() const { return this->u32_(10); }
+
+  const uint8_t *data() const { return this->data_; }
+
+ protected:
+  uint32_t u32_(uint8_t offset) const {
+    return uint32_t(this->data_[offset]) | uint32_t(this->data_[offset + 1]) << 8 |
+           uint32_t(this->data_[offset + 2]) << 16 | uint32_t(this->data_[offset + 3]) << 24;
+  }
+
+  const uint8_t *data_;
+};
+
+/// Splits a byte stream (UART, socket) into records. The caller owns the buffer: feed() returns the
+/// number of bytes consumed, the remaining bytes (a partial record) must be fed again with the next ones.
+class LacrosseRecordReader {
+ public:
+  template<typename F> size_t feed(const uint8_t *data, size_t len, F &&on_record) {
+    size_t pos = 0;
+    while (len - pos >= LACROSSE_RECORD_SIZE) {
+      if (data[pos] != LACROSSE_RECORD_SYNC) {
+        pos++;
+        this->skipped_++;
+        continue;
+      }
+      if (!lacrosse_record_valid(data + pos)) {  // a sync byte inside a record or a corrupted record
+        pos++;
+        this->crc_errors_++;
+        continue;
+      }
+      on_record(LacrosseRecordView(data + pos));
+      pos += LACROSSE_RECORD_SIZE;
+      this->records_++;
+    }
+    // keep a partial record for the next call, skip the bytes that cannot start one
+    while (pos < len && data[pos] != LACROSSE_RECORD_SYNC) {
+      pos++;
+      this->skipped_++;
+    }
+    return pos;
+  }
+
+  uint32_t get_records() const { return this->records_; }
+  uint32_t get_skipped() const { return this->skipped_; }
+  uint32_t get_crc_errors() const { return this->crc_errors_; }
+
+ protected:
+  uint32_t records_{0};
+  uint32_t skipped_{0};
+  uint32_t crc_errors_{0};
+};
+
+}  // namespace remote_base
+}  // namespace esphome
@@ -0,0 +1,632 @@
+// Host tests of the Lacrosse layer, on synthetic timelines and captures.
+//
+// Build and run, from the repository root:
+//
+//   g++ -std=gnu++17 -O1 -g -fsanitize=address,undefined -DUSE_REMOTE_BASE_HOST -Ihost -Iremote_base
+//       host/lacrosse_tests.cpp remote_base/lacrosse_protocol.cpp remote_base/lacrosse_scheduler.cpp
+//       remote_base/lacrosse_history.cpp -pthread -o lacrosse_tests
+//   ./lacrosse_tests [EDGES...]
+//
+// EDGES: recorded edges files, a "time_us level" line per edge, replayed through the ring and the framer
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "lacrosse_protocol.h"
+#include "lacrosse_synthetic.h"
+#include "lacrosse_telemetry_reader.h"
+#include "remote_edge_buffer.h"
+
+using namespace esphome;
+using namespace esphome::remote_base;
+
+static uint32_t failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+      failures++; \
+    } \
+  } while (0)
+
+// === Transmission schedule
+
+static const uint32_t TX_PERIOD_MS = 60000;
+
+/// TX12 temperature learned: arrivals at 0, 60 and 120 s, the last one expected
+static void learn_tx(LacrosseScheduler &scheduler) {
+  CHECK(scheduler.observe(LACROSSE_FAMILY_TX, 0x12, 0, 0) == ARRIVAL_FIRST);
+  CHECK(scheduler.observe(LACROSSE_FAMILY_TX, 0x12, 0, 50) == ARRIVAL_REPEAT);
+  CHECK(scheduler.observe(LACROSSE_FAMILY_TX, 0x12, 0, TX_PERIOD_MS) == ARRIVAL_LEARNING);
+  CHECK(scheduler.observe(LACROSSE_FAMILY_TX, 0x12, 0, 2 * TX_PERIOD_MS + 500) == ARRIVAL_EXPECTED);
+}
+
+static void test_schedule_learning() {
+  LacrosseScheduler scheduler;
+  learn_tx(scheduler);
+  CHECK(scheduler.size() == 1);
+  CHECK(scheduler.at(0).period_ms > TX_PERIOD_MS && scheduler.at(0).period_ms < TX_PERIOD_MS + 500);
+
+  uint32_t from_ms, to_ms;
+  CHECK(scheduler.next_window(LACROSSE_FAMILY_TX, 0x12, 0, 2 * TX_PERIOD_MS + 10000, &from_ms, &to_ms));
+  CHECK(from_ms < 3 * TX_PERIOD_MS + 500 && to_ms > 3 * TX_PERIOD_MS + 500);
+  CHECK(to_ms - from_ms < 10000);
+  CHECK(!scheduler.next_window(LACROSSE_FAMILY_WS, 0x12, 0, 0, &from_ms, &to_ms));
+
+  CHECK(scheduler.is_expected(3 * TX_PERIOD_MS + 500));
+  CHECK(!scheduler.is_expected(3 * TX_PERIOD_MS - 20000));
+  CHECK(scheduler.get_unexpected() == 0 && scheduler.get_missed() == 0);
+}
+
+static void test_schedule_unexpected_and_relearn() {
+  LacrosseScheduler scheduler;
+  learn_tx(scheduler);
+  uint32_t now_ms = 2 * TX_PERIOD_MS + 500 + TX_PERIOD_MS / 2;
+  CHECK(scheduler.observe(LACROSSE_FAMILY_TX, 0x12, 0, now_ms) == ARRIVAL_UNEXPECTED);
+  CHECK(scheduler.get_unexpected() == 1);
+  for (uint8_t i = 1; i < SCHEDULE_RELEARN; i++)
+    scheduler.observe(LACROSSE_FAMILY_TX, 0x12, 0, now_ms += 7000);
+  CHECK(scheduler.at(0).period_ms == 0);  // learning again
+}
+
+static void test_schedule_jammed_band() {
+  LacrosseScheduler scheduler;
+  learn_tx(scheduler);
+  const uint32_t last_ms = 2 * TX_PERIOD_MS + 500;
+  // 10 windows with nothing but undecodable frames, in the windows and just after them
+  for (uint32_t k = 1; k <= 10; k++) {
+    scheduler.frame_failed(last_ms + k * TX_PERIOD_MS);
+    scheduler.frame_failed(last_ms + k * TX_PERIOD_MS + 10000);
+    CHECK(scheduler.get_missed() == k);
+  }
+  CHECK(scheduler.get_failed_in_window() == 10);
+  // the sensor is back: no window reported twice
+  CHECK(scheduler.observe(LACROSSE_FAMILY_TX, 0x12, 0, last_ms + 11 * TX_PERIOD_MS) == ARRIVAL_EXPECTED);
+  CHECK(scheduler.get_missed() == 10);
+}
+
+static void test_schedule_preferred_family() {
+  LacrosseScheduler scheduler;
+  learn_tx(scheduler);
+  const uint32_t ws_period_ms = 177000;
+  scheduler.observe(LACROSSE_FAMILY_WS, 3, 4, 30000);
+  scheduler.observe(LACROSSE_FAMILY_WS, 3, 4, 30000 + ws_period_ms);
+  CHECK(scheduler.preferred_family(30000 + 2 * ws_period_ms) == LACROSSE_FAMILY_WS);
+  CHECK(scheduler.preferred_family(3 * TX_PERIOD_MS + 500) == LACROSSE_FAMILY_TX);
+  CHECK(scheduler.preferred_family(3 * TX_PERIOD_MS + 20000) == LACROSSE_FAMILY_NONE);
+}
+
+// === Sensors filter
+
+static optional<LacrosseData> decode_frame(LacrosseState &state, std::vector<int32_t> raw, uint32_t now_ms = 1000) {
+  return LacrosseProtocol(&state).decode(RemoteReceiveData(&raw, 25), now_ms);
+}
+
+/// Bit of a TX3 frame turned to its other value: the checksum no longer matches
+static std::vector<int32_t> flip_tx3_bit(std::vector<int32_t> raw, uint8_t bit) {
+  const bool one = raw[2 * bit] < 900;
+  raw[2 * bit] = one ? 1300 : 500;
+  raw[2 * bit + 1] = one ? -1000 : -1100;
+  return raw;
+}
+
+static void test_filter() {
+  LacrosseSynthetic synthetic;
+  global_lacrosse_filter = LacrosseFilter{};
+  global_lacrosse_filter.accept_address(LACROSSE_FAMILY_TX, 0x73);
+
+  LacrosseState state{};
+  CHECK(decode_frame(state, synthetic.tx3(0x73, 0x0, 21.5f)).has_value());
+  CHECK(!decode_frame(state, synthetic.tx3(0x12, 0x0, 21.5f), 2000).has_value());
+  CHECK(state.filtered == 1);
+  // dropped on its address, before the digits: a corrupted digit makes no difference
+  CHECK(!decode_frame(state, flip_tx3_bit(synthetic.tx3(0x12, 0x0, 18.5f), 24), 3000).has_value());
+  CHECK(state.filtered == 2);
+  CHECK(state.collisions.detected == 0);  // neither decoded nor failed: not split as a collision
+  // a corrupted frame of a configured sensor fails on its checksum
+  CHECK(!decode_frame(state, flip_tx3_bit(synthetic.tx3(0x73, 0x0, 18.5f), 24), 4000).has_value());
+  CHECK(state.filtered == 2);
+  CHECK(!decode_frame(state, synthetic.ws7000(3, 4, {5, 1, 2, 0, 5, 4, 3, 0, 1, 0}), 5000).has_value());
+  CHECK(state.filtered == 3);
+
+  global_lacrosse_filter = LacrosseFilter{};
+}
+
+// === Collisions
+
+static std::vector<int32_t> collide(std::vector<int32_t> tx, const std::vector<int32_t> &ws) {
+  tx.insert(tx.begin() + 24, ws.begin(), ws.end());  // the WS7000 frame starts on the 13th TX3 bit
+  return tx;
+}
+
+static void test_collision() {
+  LacrosseSynthetic synthetic;
+  const std::vector<int32_t> ws = synthetic.ws7000(2, 4, {5, 1, 2, 0, 5, 4, 3, 0, 1, 0}, 50);
+  LacrosseState state{};
+
+  // a corrupted frame of a single family is a failed frame, not a collision
+  CHECK(!decode_frame(state, flip_tx3_bit(synthetic.tx3(0x21, 0x0, 18.0f, 50), 30)).has_value());
+  CHECK(state.collisions.detected == 0 && state.collisions.lost == 0);
+
+  // both transmissions come out of the interleaved capture
+  const optional<LacrosseData> res = decode_frame(state, collide(synthetic.tx3(0x21, 0x0, 18.0f, 50), ws), 2000);
+  CHECK(state.collisions.detected == 1 && state.collisions.recovered == 2 && state.collisions.lost == 0);
+  CHECK(res.has_value() && res->iMeasures == 4);
+  if (res.has_value()) {
+    CHECK(res->measures[0].family == LACROSSE_FAMILY_TX && res->measures[0].address == 0x21);
+    CHECK(res->measures[0].quantity == '0' && std::fabs(res->measures[0].value - 18.0f) < 0.05f);
+    for (uint8_t iMeasure = 1; iMeasure < res->iMeasures; iMeasure++)
+      CHECK(res->measures[iMeasure].family == LACROSSE_FAMILY_WS && res->measures[iMeasure].address == 2);
+    CHECK(strchr(res->buf, ';') != nullptr);
+  }
+
+  // a corrupted TX3 frame under the WS7000 one: one transmission recovered, one lost
+  const optional<LacrosseData> half =
+      decode_frame(state, collide(flip_tx3_bit(synthetic.tx3(0x22, 0x0, 18.0f, 50), 30), ws), 300000);
+  CHECK(state.collisions.detected == 2 && state.collisions.recovered == 3 && state.collisions.lost == 1);
+  CHECK(half.has_value() && half->family == LACROSSE_FAMILY_WS && half->iMeasures == 3);
+}
+
+// === Schedule of the decoded frames
+
+/// WS7000-20 crossing 0 degrees: the sign in bit 3 of its address does not make it another sensor
+static void test_schedule_temperature_sign() {
+  LacrosseSynthetic synthetic;
+  LacrosseState state{};
+  const uint32_t ws_period_ms = 177000;
+  for (uint8_t i = 0; i < 9; i++) {
+    const uint8_t address = i < 3 ? 0x3 : 0x3 | 0x8;  // 3 frames above 0, 6 below
+    const optional<LacrosseData> res = decode_frame(
+        state, synthetic.ws7000(address, 4, {uint8_t(i), 1, 2, 0, 5, 4, 3, 0, 1, 0}), 1000 + i * ws_period_ms);
+    CHECK(res.has_value() && res->address == 0x3);
+  }
+  CHECK(state.scheduler.size() == 1);
+  CHECK(state.scheduler.get_missed() == 0 && state.scheduler.get_unexpected() == 0);
+}
+
+// === Bits confidence
+
+static void test_bit_confidence() {
+  LacrosseSynthetic synthetic(11);
+  for (int32_t jitter : {100, 300}) {
+    uint32_t good = 0, wrong = 0;
+    for (uint32_t i = 0; i < 20000; i++) {
+      const uint8_t address = i % 128;
+      const float value = -20.0f + (i % 600) * 0.1f;
+      LacrosseState state{};
+      const optional<LacrosseData> res = decode_frame(state, synthetic.tx3(address, 0x0, value, jitter));
+      if (res.has_value())
+        (res->address == address && std::abs(res->value - value) < 0.05f ? good : wrong)++;
+    }
+    CHECK(wrong == 0);
+    if (jitter == 100)
+      CHECK(good == 20000);
+  }
+}
+
+// === Binary telemetry
+
+static void test_telemetry_records() {
+  const float values[] = {21.5f, -12.34f, 1e17f /* brightness */, -1e17f, NAN, 1013.2f};
+  const int32_t expected[] = {2150, -1234, INT32_MAX, INT32_MIN, 0, 101320};
+  std::vector<uint8_t> bytes = {0x00, LACROSSE_RECORD_SYNC};  // garbage before the first record
+  for (uint8_t i = 0; i < 6; i++) {
+    uint8_t record[LACROSSE_RECORD_SIZE];
+    lacrosse_record_encode(LacrosseRecord{LACROSSE_FAMILY_WS, 3, 4, 'P', 90, lacrosse_fixed_point(values[i], 100),
+                                          1000u * i},
+                           record);
+    bytes.insert(bytes.end(), record, record + sizeof(record));
+  }
+  bytes[2 + 3 * LACROSSE_RECORD_SIZE + 7] ^= 0x10;  // value of the 4th record corrupted
+
+  // fed in small chunks, the bytes not consumed kept for the next call
+  LacrosseRecordReader reader;
+  std::vector<uint8_t> pending;
+  std::vector<int32_t> decoded;
+  for (size_t pos = 0; pos < bytes.size(); pos += 7) {
+    pending.insert(pending.end(), bytes.begin() + pos, bytes.begin() + std::min(pos + 7, bytes.size()));
+    const size_t used = reader.feed(pending.data(), pending.size(), [&](const LacrosseRecordView &record) {
+      CHECK(record.family() == LACROSSE_FAMILY_WS && record.address() == 3 && record.quantity() == 'P');
+      CHECK(record.timestamp_ms() % 1000 == 0);
+      decoded.push_back(record.value_centi());
+    });
+    pending.erase(pending.begin(), pending.begin() + used);
+  }
+  CHECK(reader.get_records() == 5);
+  CHECK(reader.get_crc_errors() >= 1);
+  CHECK((decoded == std::vector<int32_t>{expected[0], expected[1], expected[2], expected[4], expected[5]}));
+
+  // records written by the decoder
+  std::vector<uint8_t> written;
+  LacrosseProtocol::telemetry().set_writer(
+      [&](const uint8_t *data, size_t len) { written.insert(written.end(), data, data + len); });
+  LacrosseSynthetic synthetic;
+  LacrosseState state{};
+  decode_frame(state, synthetic.tx3(0x21, 0x0, -7.3f), 42000);
+  LacrosseProtocol::telemetry().set_writer({});
+  CHECK(written.size() == LACROSSE_RECORD_SIZE);
+  if (written.size() == LACROSSE_RECORD_SIZE) {
+    const LacrosseRecordView record(written.data());
+    CHECK(lacrosse_record_valid(written.data()));
+    CHECK(record.address() == 0x21 && record.value_centi() == -730 && record.timestamp_ms() == 42000);
+  }
+
+  // a WS7000-20 frame decoded by a trigger and a dumper: its 3 measures are written once
+  written.clear();
+  LacrosseProtocol::telemetry().set_writer(
+      [&](const uint8_t *data, size_t len) { written.insert(written.end(), data, data + len); });
+  std::vector<int32_t> raw = synthetic.ws7000(3, 4, {5, 1, 2, 0, 5, 4, 3, 0, 1, 0});
+  RemoteReceiveTimestamps timestamps{100, 120000};
+  const optional<LacrosseData> trigger =
+      LacrosseProtocol(&state).decode(RemoteReceiveData(&raw, 25, &timestamps), 43000);
+  const optional<LacrosseData> dumper =
+      LacrosseProtocol(&state).decode(RemoteReceiveData(&raw, 25, &timestamps), 43000);
+  LacrosseProtocol::telemetry().set_writer({});
+  CHECK(trigger.has_value() && dumper.has_value());
+  CHECK(written.size() == 3 * LACROSSE_RECORD_SIZE);
+}
+
+// === History
+
+struct HistoryPoint {
+  uint32_t timestamp_ms;
+  float value;
+};
+
+static std::vector<HistoryPoint> history_points(const LacrosseHistory &history, uint8_t address, uint32_t from_ms = 0,
+                                                uint32_t to_ms = UINT32_MAX) {
+  std::vector<HistoryPoint> points;
+  history.query(LACROSSE_FAMILY_TX, address, 0, from_ms, to_ms, [&](const LacrosseHistoryPoint &point) {
+    points.push_back(HistoryPoint{point.timestamp_ms, point.value});
+  });
+  return points;
+}
+
+/// Regular and irregular intervals, small and large steps, saturated values: all read back as written
+static void test_history_round_trip() {
+  const std::vector<HistoryPoint> readings = {
+      {60000, 21.5f},   {120000, 21.6f},   {181000, 21.4f},    {240000, 21.4f},  // nibbles
+      {3840000, 21.4f},                                                         // hour gap: escaped delta of delta
+      {3900000, 51.4f}, {3960000, -20.0f},                                      // escaped value deltas
+      {4020000, 1e17f}, {4080000, -1e17f}, {4140000, 21.5f},                    // saturated, the deltas wrap
+  };
+  LacrosseHistory history;
+  history.set_budget(4096);
+  for (const HistoryPoint &reading : readings) {
+    history.append(LACROSSE_FAMILY_TX, 0x21, 0, '0', reading.timestamp_ms, reading.value);
+    history.append(LACROSSE_FAMILY_WS, 0x3, 4, 'P', reading.timestamp_ms, 1013.2f);  // another series between
+  }
+  CHECK(history.get_readings() == 2 * readings.size() && history.get_dropped() == 0);
+
+  const std::vector<HistoryPoint> points = history_points(history, 0x21);
+  CHECK(points.size() == readings.size());
+  for (size_t i = 0; i < points.size() && i < readings.size(); i++) {
+    CHECK(points[i].timestamp_ms == readings[i].timestamp_ms);
+    CHECK(lacrosse_fixed_point(points[i].value, 10) == lacrosse_fixed_point(readings[i].value, 10));
+  }
+
+  // inclusive range
+  const std::vector<HistoryPoint> range = history_points(history, 0x21, 181000, 3900000);
+  CHECK(range.size() == 4 && range.front().timestamp_ms == 181000 && range.back().timestamp_ms == 3900000);
+  CHECK(history_points(history, 0x21, 181001, 239999).empty());
+  CHECK(history_points(history, 0x22).empty());
+}
+
+/// A small budget recycles the oldest blocks, the last readings stay
+static void test_history_recycling() {
+  LacrosseHistory history;
+  history.set_budget(3 * (2 * HISTORY_BLOCK_SIZE + 20));
+  CHECK(history.get_series_max() == 3);
+  CHECK(history.get_memory_used() <= 3 * (2 * HISTORY_BLOCK_SIZE + 20));
+  for (uint32_t i = 0; i < 1000; i++)  // a value step of 10.0: escaped, a few readings per block
+    history.append(LACROSSE_FAMILY_TX, 0x21, 0, '0', 60000 * (i + 1), float(i % 2 * 10));
+  CHECK(history.get_dropped() > 0);
+  CHECK(history.get_readings() + history.get_dropped() == 1000);
+
+  const std::vector<HistoryPoint> points = history_points(history, 0x21);
+  CHECK(points.size() == history.get_readings());
+  CHECK(!points.empty() && points.back().timestamp_ms == 60000 * 1000);
+  for (size_t i = 1; i < points.size(); i++)
+    CHECK(points[i].timestamp_ms == points[i - 1].timestamp_ms + 60000);
+
+  // no room for a 4th series: its reading is dropped
+  history.append(LACROSSE_FAMILY_TX, 0x22, 0, '0', 61000000, 1.0f);
+  history.append(LACROSSE_FAMILY_TX, 0x23, 0, '0', 61000000, 1.0f);
+  const uint32_t dropped = history.get_dropped();
+  history.append(LACROSSE_FAMILY_TX, 0x24, 0, '0', 61000000, 1.0f);
+  CHECK(history.get_dropped() == dropped + 1);
+}
+
+/// Drained as valid telemetry records, in writes of up to DRAIN_RECORDS records, then cleared
+static void test_history_drain() {
+  LacrosseHistory history;
+  CHECK(history.get_memory_used() == 0);  // no budget, no memory
+  history.set_budget(4096);
+  for (uint32_t i = 0; i < 100; i++)
+    history.append(LACROSSE_FAMILY_TX, uint8_t(0x10 + i % 5), 0, '0', 60000 * (i + 1), 20.0f + i * 0.1f);
+  std::vector<uint8_t> bytes;
+  uint32_t writes = 0;
+  const size_t count = history.drain([&](const uint8_t *data, size_t len) {
+    CHECK(len % LACROSSE_RECORD_SIZE == 0 && len <= LacrosseHistory::DRAIN_RECORDS * LACROSSE_RECORD_SIZE);
+    bytes.insert(bytes.end(), data, data + len);
+    writes++;
+  });
+  CHECK(count == 100 && writes == 4);
+  CHECK(bytes.size() == 100 * LACROSSE_RECORD_SIZE);
+  int64_t sum_centi = 0;
+  for (size_t pos = 0; pos + LACROSSE_RECORD_SIZE <= bytes.size(); pos += LACROSSE_RECORD_SIZE) {
+    CHECK(lacrosse_record_valid(bytes.data() + pos));
+    const LacrosseRecordView record(bytes.data() + pos);
+    CHECK(record.quality() == 0 && record.timestamp_ms() % 60000 == 0);
+    sum_centi += record.value_centi();
+  }
+  CHECK(sum_centi == 100 * 2000 + 10 * 99 * 100 / 2);  // 20.00 + i * 0.10
+  CHECK(history.get_readings() == 0 && history_points(history, 0x10).empty());
+}
+
+// === Repeated frames
+
+static void test_cache_replay() {
+  LacrosseSynthetic synthetic;
+  LacrosseState state{};
+  std::vector<int32_t> raw = synthetic.tx3(0x21, 0x0, 19.5f);
+  RemoteReceiveTimestamps timestamps{100, 60000};
+
+  // a listener and a dumper decode the same frame: it counts once
+  const optional<LacrosseData> first = LacrosseProtocol(&state).decode(RemoteReceiveData(&raw, 25, &timestamps), 1000);
+  const optional<LacrosseData> second = LacrosseProtocol(&state).decode(RemoteReceiveData(&raw, 25, &timestamps), 1000);
+  CHECK(first.has_value() && !first->cached && first->quality > 0);
+  CHECK(!second.has_value());  // deduplicated
+  CHECK(state.cache.get_misses() == 1 && state.cache.get_hits() == 0);
+  CHECK(state.latency.decode.get_count() == 1);
+  CHECK(state.latency.capture.get_count() == 1 && state.latency.queue.get_count() == 1);
+
+  // noise is rejected on its header, before any hash or lookup
+  std::vector<int32_t> noise;
+  for (int32_t i = 0; i < 200; i++)
+    noise.push_back(i % 2 ? -(150 + i * 37 % 900) : 150 + i * 53 % 700);
+  CHECK(!decode_frame(state, noise, 2000).has_value());
+  CHECK(state.cache.get_misses() == 1 && state.cache.get_hits() == 0);
+
+  // the same reading sent again: a hit, leaving the link quality and the decode stage alone
+  const uint8_t quality = state.sensors[0].quality;
+  timestamps = RemoteReceiveTimestamps{61000100, 61060000};
+  CHECK(!LacrosseProtocol(&state).decode(RemoteReceiveData(&raw, 25, &timestamps), 62000).has_value());
+  CHECK(state.cache.get_misses() == 1 && state.cache.get_hits() == 1);
+  CHECK(state.sensors[0].quality == quality);
+  CHECK(state.latency.decode.get_count() == 1);
+
+  // not deduplicated, a WS7000 reading comes out of the cache without the quality of the first capture
+  raw = synthetic.ws7000(3, 4, {5, 1, 2, 0, 5, 4, 3, 0, 1, 0});
+  const optional<LacrosseData> ws = decode_frame(state, raw, 63000);
+  const optional<LacrosseData> cached = decode_frame(state, raw, 240000);
+  CHECK(ws.has_value() && !ws->cached && ws->quality > 0);
+  CHECK(cached.has_value() && cached->cached && cached->quality == 0 && cached->iMeasures == 3);
+  if (ws.has_value() && cached.has_value())  // formatted again from the compact entry
+    CHECK(strcmp(cached->buf, ws->buf) == 0 && cached->measures[2].value == ws->measures[2].value);
+  CHECK(state.cache.get_misses() == 2 && state.cache.get_hits() == 2);
+}
+
+// === Transmission in RMT items
+
+/// Every TX3 reading encoded in items at the RMT clock, expanded to durations and decoded again
+static void test_items_round_trip() {
+  for (uint32_t clock_divider : {80u, 10u, 3u, 1u}) {  // 1 us ticks down to 1/80 us: pulses split over items
+    RemoteTransmitItems items;
+    const RemoteTransmitItem *storage = nullptr;
+    for (uint8_t address = 0; address < 0x80; address++) {
+      for (uint8_t type : {0x0, 0xE}) {
+        LacrosseData data{};
+        data.family = LACROSSE_FAMILY_TX;
+        data.address = address;
+        data.type = type;
+        data.value = type == 0 ? -29.9f + address * 0.6f : address * 0.7f;  // up to 46.3 C, 88.9 %
+        items.reset(80000000u / clock_divider / 100000u);
+        LacrosseProtocol().encode(&items, data);
+        if (clock_divider == 80)
+          CHECK(items.size() == 44);  // one item per bit
+        if (storage != nullptr)
+          CHECK(items.data() == storage);  // the buffer is kept from one frame to the next
+        storage = items.data();
+
+        RemoteTransmitData sent;
+        items.to_data(&sent);
+        RemoteTransmitData expected;
+        LacrosseProtocol().encode(&expected, data);
+        CHECK(sent.get_data() == expected.get_data());
+
+        LacrosseState state{};
+        const optional<LacrosseData> res = decode_frame(state, sent.get_data());
+        CHECK(res.has_value() && res->address == address && res->type == type);
+        if (res.has_value())
+          CHECK(std::abs(res->value - data.value) < 0.05f);
+      }
+    }
+  }
+}
+
+// === Edges of the receivers without RMT
+
+struct Edge {
+  uint32_t time_us;
+  bool level;
+};
+
+/// Edges of the durations (mark > 0, space < 0) starting at time_us, the last one included
+static void append_edges(std::vector<Edge> &edges, uint32_t &time_us, const std::vector<int32_t> &durations) {
+  for (int32_t duration : durations) {
+    edges.push_back(Edge{time_us, duration > 0});
+    time_us += std::abs(duration);
+  }
+  edges.push_back(Edge{time_us, false});
+}
+
+static std::vector<int32_t> frame_edges(RemoteEdgeFramer &framer, const std::vector<Edge> &edges) {
+  RemoteEdgeBuffer<256> buffer;
+  std::vector<int32_t> data;
+  for (const Edge &edge : edges)
+    buffer.push(edge.time_us, edge.level);
+  framer.read(buffer, data, edges.back().time_us + 100000);
+  return data;
+}
+
+static void test_edge_glitch() {
+  const uint32_t start_us = 100000;
+  std::vector<Edge> edges;
+  uint32_t time_us = start_us;
+  append_edges(edges, time_us, {500, -1100, 1300, -1000, 500, -1100});
+  // 30 us dropout 600 us into the 1300 us mark
+  const uint32_t mark_us = start_us + 1600;
+  edges.insert(edges.begin() + 3, {Edge{mark_us + 600, false}, Edge{mark_us + 630, true}});
+
+  RemoteEdgeFramer framer(100, 10000);
+  CHECK((frame_edges(framer, edges) == std::vector<int32_t>{500, -1100, 1300, -1000, 500, -10000}));
+
+  // a spike in a space, and a glitch starting the frame
+  edges.clear();
+  time_us = start_us;
+  append_edges(edges, time_us, {500, -1100, 1300, -1000});
+  edges.insert(edges.begin() + 2, {Edge{start_us + 800, true}, Edge{start_us + 840, false}});
+  edges.insert(edges.begin(), {Edge{start_us - 3000, true}, Edge{start_us - 2980, false}});
+  RemoteEdgeFramer other(100, 10000);
+  CHECK((frame_edges(other, edges) == std::vector<int32_t>{500, -1100, 1300, -10000}));
+}
+
+/// Edges file: a "time_us level" line per edge, '#' starts a comment
+static std::vector<Edge> read_edges(FILE *file) {
+  std::vector<Edge> edges;
+  char line[128];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    unsigned long time_us;
+    int level;
+    if (line[0] != '#' && sscanf(line, "%lu %d", &time_us, &level) == 2)
+      edges.push_back(Edge{uint32_t(time_us), level != 0});
+  }
+  return edges;
+}
+
+static void write_edges(FILE *file, const std::vector<Edge> &edges) {
+  fprintf(file, "# time_us level\n");
+  for (const Edge &edge : edges)
+    fprintf(file, "%u %d\n", edge.time_us, edge.level);
+}
+
+/// Edges pushed by a thread at their own pace, as the ISR would, and read by the loop through the
+/// ring and the framer: on_frame(data, close_us) per frame. Returns the overflows of the ring.
+template<typename F> static uint32_t replay_edges(const std::vector<Edge> &edges, F &&on_frame) {
+  RemoteEdgeBuffer<64> buffer;  // smaller than a frame
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> clock_us{edges.front().time_us};  // replay time, the micros() of the loop
+  std::thread isr([&] {
+    for (const Edge &edge : edges) {
+      while (buffer.available() >= 64)  // the edges are microseconds apart, much slower than the reader
+        std::this_thread::yield();
+      clock_us = edge.time_us;
+      buffer.push(edge.time_us, edge.level);
+    }
+    done = true;
+  });
+
+  RemoteEdgeFramer framer(100, 10000);
+  std::vector<int32_t> data;
+  for (bool finished = false; !finished;) {
+    finished = done;  // read once more after the last edge
+    const uint32_t now_us = finished ? edges.back().time_us + 100000 : clock_us.load();
+    while (framer.read(buffer, data, now_us)) {
+      on_frame(data, framer.get_close_us());
+      data.clear();
+    }
+  }
+  isr.join();
+  return buffer.get_overflows();
+}
+
+/// TX3 frames written to an edges file, read back and replayed
+static void test_edge_replay() {
+  LacrosseSynthetic synthetic(3);
+  std::vector<Edge> edges;
+  std::vector<float> values;
+  uint32_t time_us = 1000000;
+  for (uint8_t i = 0; i < 20; i++) {
+    values.push_back(-10.0f + i * 1.7f);
+    append_edges(edges, time_us, synthetic.tx3(0x21 + i, 0x0, values.back(), 120));
+    time_us += 30000;
+  }
+  FILE *file = tmpfile();
+  CHECK(file != nullptr);
+  if (file == nullptr)
+    return;
+  write_edges(file, edges);
+  rewind(file);
+  const std::vector<Edge> read = read_edges(file);
+  fclose(file);
+  CHECK(read.size() == edges.size() && read.back().time_us == edges.back().time_us);
+
+  LacrosseState state{};
+  uint8_t frames = 0, decoded = 0;
+  const uint32_t overflows = replay_edges(read, [&](std::vector<int32_t> &data, uint32_t) {
+    const optional<LacrosseData> res = LacrosseProtocol(&state).decode(RemoteReceiveData(&data, 25), frames * 61000);
+    if (res.has_value() && res->address == 0x21 + frames && std::abs(res->value - values[frames]) < 0.05f)
+      decoded++;
+    frames++;
+  });
+  CHECK(frames == 20);
+  CHECK(decoded == 20);
+  CHECK(overflows == 0);
+}
+
+/// Recorded edges files given on the command line: the decoded frames are printed
+static void replay_capture(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == nullptr) {
+    perror(path);
+    failures++;
+    return;
+  }
+  const std::vector<Edge> edges = read_edges(file);
+  fclose(file);
+  if (edges.empty())
+    return;
+  LacrosseState state{};
+  uint32_t frames = 0, decoded = 0;
+  const uint32_t overflows = replay_edges(edges, [&](std::vector<int32_t> &data, uint32_t close_us) {
+    const optional<LacrosseData> res = LacrosseProtocol(&state).decode(RemoteReceiveData(&data, 25), close_us / 1000);
+    if (res.has_value()) {
+      printf("%s\n", res->buf);
+      decoded++;
+    }
+    frames++;
+  });
+  printf("%s: %zu edges, %u frames, %u decoded, %u overflows\n", path, edges.size(), frames, decoded, overflows);
+}
+
+int main(int argc, char **argv) {
+  test_schedule_learning();
+  test_schedule_unexpected_and_relearn();
+  test_schedule_jammed_band();
+  test_schedule_preferred_family();
+  test_filter();
+  test_collision();
+  test_schedule_temperature_sign();
+  test_bit_confidence();
+  test_telemetry_records();
+  test_history_round_trip();
+  test_history_recycling();
+  test_history_drain();
+  test_cache_replay();
+  test_items_round_trip();
+  test_edge_glitch();
+  test_edge_replay();
+  for (int iArg = 1; iArg < argc; iArg++)
+    replay_capture(argv[iArg]);
+
+  if (failures != 0) {
+    printf("%u check(s) failed\n", failures);
+    return 1;
+  }
+  printf("all tests passed\n");
+  return 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace esphome {
+namespace remote_base {
+
+/// Thread pool with a task deque per worker: a worker runs its own tasks last in first out and,
+/// when it has none left, steals the oldest task of another worker.
+class WorkStealingPool {
+ public:
+  using task_t = std::function<void()>;
+
+  explicit WorkStealingPool(unsigned workers = std::thread::hardware_concurrency()) {
+    if (workers == 0)
+      workers = 1;
+    for (unsigned i = 0; i < workers; i++)
+      this->queues_.emplace_back(new Queue());
+    for (unsigned i = 0; i < workers; i++)
+      this->threads_.emplace_back([this, i] { this->run_(i); });
+  }
+
+  ~WorkStealingPool() {
+    this->wait();
+    {
+      std::lock_guard<std::mutex> lock(this->idle_mutex_);
+      this->stop_ = true;
+    }
+    this->idle_.notify_all();
+    for (auto &thread : this->threads_)
+      thread.join();
+  }
+
+  /// Queue a task: on the current worker when called from a task, round robin otherwise
+  void submit(task_t &&task) {
+    const unsigned index = current_ != nullptr && current_->pool == this
+                               ? current_->index
+                               : this->next_.fetch_add(1, std::memory_order_relaxed) % this->queues_.size();
+    {
+      std::lock_guard<std::mutex> lock(this->idle_mutex_);  // counted first: popped before counted would wrap
+      this->queued_++;
+      this->pending_++;
+    }
+    {
+      std::lock_guard<std::mutex> lock(this->queues_[index]->mutex);
+      this->queues_[index]->tasks.push_back(std::move(task));
+    }
+    this->idle_.notify_one();
+  }
+
+  /// Wait until all the submitted tasks, and the tasks they submitted, are done
+  void wait() {
+    std::unique_lock<std::mutex> lock(this->idle_mutex_);
+    this->done_.wait(lock, [this] { return this->pending_ == 0; });
+  }
+
+  unsigned size() const { return this->queues_.size(); }
+  uint64_t get_steals() const { return this->steals_.load(std::memory_order_relaxed); }
+
+ protected:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<task_t> tasks;
+  };
+  struct Worker {
+    WorkStealingPool *pool;
+    unsigned index;
+  };
+
+  bool pop_(unsigned index, task_t *task) {
+    {
+      Queue &own = *this->queues_[index];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        *task = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
+      }
+    }
+    for (unsigned i = 1; i < this->queues_.size(); i++) {
+      Queue &victim = *this->queues_[(index + i) % this->queues_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        *task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        this->steals_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void run_(unsigned index) {
+    Worker worker{this, index};
+    current_ = &worker;
+    task_t task;
+    while (true) {
+      if (this->pop_(index, &task)) {
+        {
+          std::lock_guard<std::mutex> lock(this->idle_mutex_);
+          this->queued_--;
+        }
+        task();
+        task = nullptr;
+        std::lock_guard<std::mutex> lock(this->idle_mutex_);
+        if (--this->pending_ == 0)
+          this->done_.notify_all();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(this->idle_mutex_);
+      this->idle_.wait(lock, [this] { return this->stop_ || this->queued_ > 0; });
+      if (this->stop_ && this->queued_ == 0)
+        return;
+    }
+  }
+
+  static thread_local Worker *current_;
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<unsigned> next_{0};
+  std::atomic<uint64_t> steals_{0};
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+  std::condition_variable done_;
+  size_t queued_{0};   // in the deques
+  size_t pending_{0};  // queued or running
+  bool stop_{false};
+};
+
+inline thread_local WorkStealingPool::Worker *WorkStealingPool::current_ = nullptr;
+
+}  // namespace remote_base
+}  // namespace esphome
@@ -0,0 +1,37 @@
+#include "esphome.h"
+
+// Publishes the 95th percentile (ms) of the latency of each stage of the Lacrosse frames:
+// capture (first edge -> frame close), queue (-> decode start), decode (-> dedupe decision),
+// dedupe (-> decode end) and publish (-> publish_state of LacrosseTx3Sensor).
+
+class LacrosseLatencySensor : public PollingComponent {
+
+  public:
+    Sensor *capture_sensor = new Sensor();
+    Sensor *queue_sensor = new Sensor();
+    Sensor *decode_sensor = new Sensor();
+    Sensor *dedupe_sensor = new Sensor();
+    Sensor *publish_sensor = new Sensor();
+
+    LacrosseLatencySensor() : PollingComponent(60000) { 
+    }
+
+    void setup() override {
+    }
+
+    void update() override {
+      remote_base::LacrosseLatency &latency = remote_base::LacrosseProtocol::latency();
+      publish_( this->capture_sensor, latency.capture );
+      publish_( this->queue_sensor, latency.queue );
+      publish_( this->decode_sensor, latency.decode );
+      publish_( this->dedupe_sensor, latency.dedupe );
+      publish_( this->publish_sensor, latency.publish );
+    }
+
+  protected:
+    void publish_( Sensor *sensor, const remote_base::LatencyHistogram &histogram ) {
+      if (histogram.get_count()>0) {
+        sensor->publish_state( histogram.percentile(95) / 1000.0 );
+      }
+    }
+};
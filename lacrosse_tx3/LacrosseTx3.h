@@ -7,6 +7,7 @@ class LacrosseTx3Sensor : public PollingComponent {
 
   protected:
     std::string address_;
+    uint8_t iAddress_;
 
   public:
     Sensor *temperature_sensor = new Sensor();
@@ -14,6 +15,7 @@ class LacrosseTx3Sensor : public PollingComponent {
 
     LacrosseTx3Sensor( const std::string &address ) : PollingComponent(15000) { 
       address_ = address; 
+      iAddress_ = std::stoi(address.substr(2,2), nullptr, 16);
     }
 
     void setup() override {
@@ -48,6 +50,7 @@ class LacrosseTx3Sensor : public PollingComponent {
          } else if (sType=="E") {
            this->humidity_sensor->publish_state(fValue);
          } 
+         remote_base::LacrosseProtocol::latency().record_publish(remote_base::LACROSSE_FAMILY_TX, iAddress_, micros());
       }
     }
   }
@@ -1,3 +1,5 @@
+import re
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome import automation
@@ -23,6 +25,7 @@ from esphome.const import (
     CONF_REPEAT,
     CONF_WAIT_TIME,
     CONF_TIMES,
+    CONF_TYPE,
     CONF_TYPE_ID,
     CONF_CARRIER_FREQUENCY,
     CONF_RC_CODE_1,
@@ -30,8 +33,9 @@ from esphome.const import (
     CONF_MAGNITUDE,
     CONF_WAND_ID,
     CONF_LEVEL,
+    CONF_VALUE,
 )
-from esphome.core import coroutine
+from esphome.core import ID, coroutine
 from esphome.schema_extractors import SCHEMA_EXTRACT, schema_extractor
 from esphome.util import Registry, SimpleRegistry
 
@@ -54,6 +58,10 @@ RemoteTransmitterActionBase = ns.class_(
     "RemoteTransmitterActionBase", automation.Action
 )
 RemoteReceiverBase = ns.class_("RemoteReceiverBase")
+RemoteReceiverDumperBase = ns.class_("RemoteReceiverDumperBase")
+RemoteReceiverStaticDumper = ns.class_(
+    "RemoteReceiverStaticDumper", RemoteReceiverDumperBase
+)
 RemoteTransmitterBase = ns.class_("RemoteTransmitterBase")
 
 
@@ -66,6 +74,11 @@ def templatize(value):
     return cv.Schema(ret)
 
 
+def use_protocol(name):
+    """Only the protocols used by the configuration are built: USE_REMOTE_BASE_<NAME>"""
+    cg.add_define(f"USE_REMOTE_BASE_{re.sub('[^0-9A-Z]', '_', name.upper())}")
+
+
 async def register_listener(var, config):
     receiver = await cg.get_variable(config[CONF_RECEIVER_ID])
     cg.add(receiver.register_listener(var))
@@ -86,6 +99,7 @@ def register_trigger(name, type, data_type):
 
     def decorator(func):
         async def new_func(config):
+            use_protocol(name)
             var = cg.new_Pvariable(config[CONF_TRIGGER_ID])
             await register_listener(var, config)
             await coroutine(func)(var, config)
@@ -97,12 +111,12 @@ def register_trigger(name, type, data_type):
     return decorator
 
 
-def register_dumper(name, type):
-    registerer = DUMPER_REGISTRY.register(name, type, {})
+def register_dumper(name, type, schema=None):
+    registerer = DUMPER_REGISTRY.register(name, type, schema or {})
 
     def decorator(func):
-        async def new_func(config, dumper_id):
-            var = cg.new_Pvariable(dumper_id)
+        async def new_func(config, var):
+            use_protocol(name)
             await coroutine(func)(var, config)
             return var
 
@@ -140,6 +154,7 @@ def register_action(name, type_, schema):
 
     def decorator(func):
         async def new_func(config, action_id, template_arg, args):
+            use_protocol(name)
             transmitter = await cg.get_variable(config[CONF_TRANSMITTER_ID])
             var = cg.new_Pvariable(action_id, template_arg)
             cg.add(var.set_parent(transmitter))
@@ -215,6 +230,7 @@ async def build_binary_sensor(full_config):
     )
     type_id = full_config[CONF_TYPE_ID]
     builder = registry_entry.coroutine_fun
+    use_protocol(registry_entry.name)
     var = cg.new_Pvariable(type_id)
     await cg.register_component(var, full_config)
     await register_listener(var, full_config)
@@ -230,11 +246,25 @@ async def build_triggers(full_config):
 
 
 async def build_dumpers(config):
-    dumpers = []
+    """One RemoteReceiverStaticDumper holding the configured dumpers, called without virtual dispatch.
+
+    The configuration functions of the dumpers receive this static dumper.
+    """
+    if not config:
+        return []
+    types = [conf[CONF_TYPE_ID].type for conf in config]
+    dumper_id = ID(
+        f"{config[0][CONF_TYPE_ID].id}_static",
+        is_declaration=True,
+        type=RemoteReceiverStaticDumper,
+    )
+    var = cg.new_Pvariable(dumper_id, cg.TemplateArguments(*types))
     for conf in config:
-        dumper = await cg.build_registry_entry(DUMPER_REGISTRY, conf)
-        dumpers.append(dumper)
-    return dumpers
+        registry_entry, entry_config = cg.extract_registry_entry_config(
+            DUMPER_REGISTRY, conf
+        )
+        await registry_entry.coroutine_fun(entry_config, var)
+    return [var]
 
 
 # Coolix
@@ -1401,6 +1431,53 @@ LACROSSE_SCHEMA = cv.Schema(
     }
 )
 
+# Accept set of the sensors decoded, in the buffer format: TXaa[t] or WSa[t] (hexadecimal)
+# without the type, all the types of the address are accepted.
+
+CONF_DISCOVERY = "discovery"
+CONF_HISTORY_SIZE = "history_size"
+CONF_SENSORS = "sensors"
+
+LACROSSE_FAMILIES = {"TX": 0, "WS": 1}
+global_lacrosse_filter = ns.global_lacrosse_filter
+LacrosseProtocol = ns.class_("LacrosseProtocol")
+
+
+def validate_lacrosse_sensor(value):
+    value = cv.string_strict(value).upper()
+    match = re.match(r"^(TX)([0-9A-F]{2})([0-9A-F])?$|^(WS)([0-7])([0-9A-F])?$", value)
+    if match is None:
+        raise cv.Invalid(
+            f"Invalid Lacrosse sensor '{value}', expected TXaa[t] or WSa[t] in hexadecimal"
+        )
+    family, address, type_ = match.group(1, 2, 3) if match.group(1) else match.group(4, 5, 6)
+    if int(address, 16) > 0x7F:
+        raise cv.Invalid(f"Invalid Lacrosse sensor '{value}', TX addresses are 7 bits (00 to 7F)")
+    return {
+        CONF_PROTOCOL: family,
+        CONF_ADDRESS: int(address, 16),
+        CONF_TYPE: None if type_ is None else int(type_, 16),
+    }
+
+
+LACROSSE_DUMPER_SCHEMA = cv.Schema(
+    {
+        cv.Optional(CONF_SENSORS, default=[]): cv.ensure_list(validate_lacrosse_sensor),
+        cv.Optional(CONF_DISCOVERY, default=False): cv.boolean,
+        # bytes of RAM keeping the readings while the collector cannot be reached, 0: no history;
+        # a series (sensor quantity) per 2 blocks of 64 bytes, up to 256
+        cv.Optional(CONF_HISTORY_SIZE, default=0): cv.int_range(min=0, max=1048576),
+    }
+)
+
+
+def lacrosse_accept(family, address, type_=None):
+    if type_ is None:
+        cg.add(global_lacrosse_filter.accept_address(LACROSSE_FAMILIES[family], address))
+    else:
+        cg.add(global_lacrosse_filter.accept(LACROSSE_FAMILIES[family], address, type_))
+
+
 @register_binary_sensor("lacrosse", LacrosseBinarySensor, LACROSSE_SCHEMA)
 def lacrosse_binary_sensor(var, config):
     cg.add(
@@ -1416,12 +1493,35 @@ def lacrosse_binary_sensor(var, config):
 def pronto_trigger(var, config):
     pass
 
-@register_dumper("lacrosse", LacrosseDumper)
+@register_dumper("lacrosse", LacrosseDumper, LACROSSE_DUMPER_SCHEMA)
 def lacrosse_dumper(var, config):
-    pass
+    for sensor in config[CONF_SENSORS]:
+        lacrosse_accept(sensor[CONF_PROTOCOL], sensor[CONF_ADDRESS], sensor[CONF_TYPE])
+    if config[CONF_DISCOVERY]:
+        cg.add(global_lacrosse_filter.set_discovery(True))
+    if config[CONF_HISTORY_SIZE] > 0:
+        cg.add(
+            cg.RawExpression(
+                f"{LacrosseProtocol}::history().set_budget({config[CONF_HISTORY_SIZE]})"
+            )
+        )
+
+# TX3 reading sent: type 0 temperature (-50.0 to 49.9), 0xE humidity (0.0 to 99.9)
 
-@register_action("lacrosse", LacrosseAction, LACROSSE_SCHEMA)
+LACROSSE_ACTION_SCHEMA = cv.Schema(
+    {
+        cv.Required(CONF_ADDRESS): cv.int_range(min=0, max=127),
+        cv.Optional(CONF_TYPE, default=0): cv.one_of(0x0, 0xE, int=True),
+        cv.Required(CONF_VALUE): cv.float_,
+    }
+)
+
+
+@register_action("lacrosse", LacrosseAction, LACROSSE_ACTION_SCHEMA)
 async def lacrosse_action(var, config, args):
-    template_ = await cg.templatable(config[CONF_ADDRESS], args, cg.uint16)
+    template_ = await cg.templatable(config[CONF_ADDRESS], args, cg.uint8)
     cg.add(var.set_address(template_))
-    cg.add(var.set_data(config[CONF_DATA]))
+    template_ = await cg.templatable(config[CONF_TYPE], args, cg.uint8)
+    cg.add(var.set_type(template_))
+    template_ = await cg.templatable(config[CONF_VALUE], args, cg.float_)
+    cg.add(var.set_value(template_))
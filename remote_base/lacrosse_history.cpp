@@ -0,0 +1,243 @@
+#include "lacrosse_history.h"
+#include "lacrosse_telemetry.h"
+#ifndef USE_REMOTE_BASE_HOST
+#include "esphome/core/defines.h"
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(USE_REMOTE_BASE_LACROSSE) || defined(USE_REMOTE_BASE_HOST)
+
+namespace esphome {
+namespace remote_base {
+
+static const uint8_t NIBBLE_ESCAPE = 0xF;
+
+static uint32_t zigzag(int32_t value) { return (uint32_t(value) << 1) ^ uint32_t(value >> 31); }
+static int32_t unzigzag(uint32_t value) { return int32_t(value >> 1) ^ -int32_t(value & 1); }
+
+static uint8_t putVarint(uint8_t *out, uint32_t value) {
+  uint8_t len = 0;
+  while (value >= 0x80) {
+    out[len++] = uint8_t(value) | 0x80;
+    value >>= 7;
+  }
+  out[len++] = value;
+  return len;
+}
+
+static uint32_t getVarint(const uint8_t *in, uint8_t *pos) {
+  uint32_t value = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    const uint8_t byte = in[(*pos)++];
+    value |= uint32_t(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      break;
+  }
+  return value;
+}
+
+void LacrosseHistory::set_budget(size_t bytes) {
+  const size_t series = std::min<size_t>(bytes / (2 * HISTORY_BLOCK_SIZE + sizeof(Series)), HISTORY_SERIES_MAX);
+  const size_t count = series == 0 ? 0 : std::min<size_t>((bytes - series * sizeof(Series)) / HISTORY_BLOCK_SIZE,
+                                                          HISTORY_BLOCK_NONE - 1);
+  this->blocks_.reset(count > 0 ? new Block[count] : nullptr);
+  this->series_.reset(count > 0 ? new Series[series] : nullptr);
+  this->blocks_count_ = count;
+  this->series_max_ = count > 0 ? series : 0;
+  this->clear();
+}
+
+void LacrosseHistory::clear() {
+  this->free_ = HISTORY_BLOCK_NONE;
+  for (uint16_t iBlock = this->blocks_count_; iBlock-- > 0;) {
+    this->blocks_[iBlock].next = this->free_;
+    this->free_ = iBlock;
+  }
+  this->blocks_used_ = 0;
+  this->series_count_ = 0;
+  this->readings_ = 0;
+}
+
+void LacrosseHistory::recycle_oldest_() {
+  Series *oldest = nullptr;
+  for (uint16_t iSeries = 0; iSeries < this->series_count_; iSeries++) {
+    Series &series = this->series_[iSeries];
+    if (series.head != HISTORY_BLOCK_NONE &&
+        (oldest == nullptr || this->blocks_[series.head].start_tick < this->blocks_[oldest->head].start_tick))
+      oldest = &series;
+  }
+  if (oldest == nullptr)
+    return;
+  const uint16_t iBlock = oldest->head;
+  Block &block = this->blocks_[iBlock];
+  this->dropped_ += block.count;
+  this->readings_ -= block.count;
+  oldest->head = block.next;
+  if (oldest->head == HISTORY_BLOCK_NONE)
+    oldest->tail = HISTORY_BLOCK_NONE;
+  block.next = this->free_;
+  this->free_ = iBlock;
+  this->blocks_used_--;
+}
+
+uint16_t LacrosseHistory::allocate_() {
+  if (this->free_ == HISTORY_BLOCK_NONE)
+    this->recycle_oldest_();
+  const uint16_t iBlock = this->free_;
+  this->free_ = this->blocks_[iBlock].next;
+  this->blocks_used_++;
+  return iBlock;
+}
+
+void LacrosseHistory::append(uint8_t family, uint8_t address, uint8_t type, char quantity, uint32_t now_ms,
+                             float value) {
+  if (!this->is_enabled())
+    return;
+
+  Series *series = nullptr;
+  for (uint16_t iSeries = 0; iSeries < this->series_count_ && series == nullptr; iSeries++) {
+    Series &candidate = this->series_[iSeries];
+    if (candidate.family == family && candidate.address == address && candidate.type == type &&
+        candidate.quantity == quantity)
+      series = &candidate;
+  }
+  if (series == nullptr) {
+    if (this->series_count_ == this->series_max_) {
+      this->dropped_++;
+      return;
+    }
+    series = &this->series_[this->series_count_++];
+    *series = Series{family, address, type, quantity, HISTORY_BLOCK_NONE, HISTORY_BLOCK_NONE, 0, 0, 0};
+  }
+
+  const uint32_t tick = now_ms / HISTORY_TICK_MS;
+  const int32_t iValue = lacrosse_fixed_point(value, HISTORY_VALUE_SCALE);
+  const bool bFirst = series->head == HISTORY_BLOCK_NONE;
+  const int32_t delta = bFirst ? 0 : int32_t(tick - series->last_tick);
+
+  if (!bFirst) {
+    uint8_t aPacked[1 + 2 * 5];
+    uint8_t len = 1;
+    const uint32_t iDod = zigzag(delta - series->last_delta);
+    const uint32_t iDv = zigzag(int32_t(uint32_t(iValue) - uint32_t(series->last_value)));  // saturated values may wrap
+    aPacked[0] = (iDod < NIBBLE_ESCAPE ? iDod : NIBBLE_ESCAPE) << 4 | (iDv < NIBBLE_ESCAPE ? iDv : NIBBLE_ESCAPE);
+    if (iDod >= NIBBLE_ESCAPE)
+      len += putVarint(aPacked + len, iDod);
+    if (iDv >= NIBBLE_ESCAPE)
+      len += putVarint(aPacked + len, iDv);
+
+    Block &tail = this->blocks_[series->tail];
+    if (tail.used + len <= sizeof(tail.payload)) {
+      memcpy(tail.payload + tail.used, aPacked, len);
+      tail.used += len;
+      tail.count++;
+      series->last_tick = tick;
+      series->last_delta = delta;
+      series->last_value = iValue;
+      this->readings_++;
+      return;
+    }
+  }
+
+  // new block, starting with the reading in full
+
+  const uint16_t iBlock = this->allocate_();
+  const int16_t start_delta = delta >= INT16_MIN && delta <= INT16_MAX ? delta : 0;
+  Block &block = this->blocks_[iBlock];
+  block.start_tick = tick;
+  block.start_value = iValue;
+  block.start_delta = start_delta;
+  block.next = HISTORY_BLOCK_NONE;
+  block.count = 1;
+  block.used = 0;
+  if (series->tail == HISTORY_BLOCK_NONE) {  // first block, or all recycled
+    series->head = iBlock;
+  } else {
+    this->blocks_[series->tail].next = iBlock;
+  }
+  series->tail = iBlock;
+  series->last_tick = tick;
+  series->last_delta = start_delta;
+  series->last_value = iValue;
+  this->readings_++;
+}
+
+template<typename F> void LacrosseHistory::decode_(const Series &series, F &&callback) const {
+  for (uint16_t iBlock = series.head; iBlock != HISTORY_BLOCK_NONE; iBlock = this->blocks_[iBlock].next) {
+    const Block &block = this->blocks_[iBlock];
+    uint32_t tick = block.start_tick;
+    int32_t delta = block.start_delta;
+    int32_t iValue = block.start_value;
+    uint8_t pos = 0;
+    for (uint8_t iReading = 0; iReading < block.count; iReading++) {
+      if (iReading > 0) {
+        const uint8_t packed = block.payload[pos++];
+        const uint32_t iDod = packed >> 4 == NIBBLE_ESCAPE ? getVarint(block.payload, &pos) : packed >> 4;
+        const uint32_t iDv = (packed & 0xF) == NIBBLE_ESCAPE ? getVarint(block.payload, &pos) : packed & 0xF;
+        delta += unzigzag(iDod);
+        tick += delta;
+        iValue = int32_t(uint32_t(iValue) + uint32_t(unzigzag(iDv)));
+      }
+      callback(LacrosseHistoryPoint{
+          .family = series.family,
+          .address = series.address,
+          .type = series.type,
+          .quantity = series.quantity,
+          .timestamp_ms = tick * HISTORY_TICK_MS,
+          .value = float(iValue) / HISTORY_VALUE_SCALE,
+      });
+    }
+  }
+}
+
+size_t LacrosseHistory::query(uint8_t family, uint8_t address, uint8_t type, uint32_t from_ms, uint32_t to_ms,
+                              const point_callback_t &callback) const {
+  size_t count = 0;
+  for (uint16_t iSeries = 0; iSeries < this->series_count_; iSeries++) {
+    const Series &series = this->series_[iSeries];
+    if (series.family != family || series.address != address || series.type != type)
+      continue;
+    this->decode_(series, [&](const LacrosseHistoryPoint &point) {
+      if (point.timestamp_ms >= from_ms && point.timestamp_ms <= to_ms) {
+        callback(point);
+        count++;
+      }
+    });
+  }
+  return count;
+}
+
+size_t LacrosseHistory::drain(const writer_t &writer) {
+  uint8_t aRecords[DRAIN_RECORDS * LACROSSE_RECORD_SIZE];
+  uint8_t iRecords = 0;
+  size_t count = 0;
+  for (uint16_t iSeries = 0; iSeries < this->series_count_; iSeries++) {
+    this->decode_(this->series_[iSeries], [&](const LacrosseHistoryPoint &point) {
+      lacrosse_record_encode(LacrosseRecord{
+          .family = point.family,
+          .address = point.address,
+          .type = point.type,
+          .quantity = point.quantity,
+          .quality = 0,
+          .value_centi = lacrosse_fixed_point(point.value, 100),
+          .timestamp_ms = point.timestamp_ms,
+      }, aRecords + iRecords * LACROSSE_RECORD_SIZE);
+      count++;
+      if (++iRecords == DRAIN_RECORDS) {
+        writer(aRecords, sizeof(aRecords));
+        iRecords = 0;
+      }
+    });
+  }
+  if (iRecords > 0)
+    writer(aRecords, iRecords * LACROSSE_RECORD_SIZE);
+  this->clear();
+  return count;
+}
+
+}  // namespace remote_base
+}  // namespace esphome
+
+#endif  // USE_REMOTE_BASE_LACROSSE
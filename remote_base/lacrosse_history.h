@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace esphome {
+namespace remote_base {
+
+// History of the readings kept in RAM while the link to the collector is down, then sent back in one
+// burst of binary telemetry records.
+//
+// Each series (sensor and quantity) is a chain of 64 bytes blocks taken from a pool of fixed size.
+// A block holds its first reading in full, the next ones packed in a byte each in the usual case:
+// high nibble the zigzag delta of delta of the timestamp (s), low nibble the zigzag delta of the
+// value (0.1). A nibble 0xF is an escape: the full zigzag varint follows, timestamp first. When the
+// pool is exhausted the oldest block of all the series is recycled.
+
+static const uint16_t HISTORY_SERIES_MAX = 256; // the series table takes a series per 2 blocks of the budget
+static const uint8_t HISTORY_BLOCK_SIZE = 64;
+static const uint32_t HISTORY_TICK_MS = 1000;  // timestamps resolution
+static const int32_t HISTORY_VALUE_SCALE = 10; // values resolution: 0.1
+static const uint16_t HISTORY_BLOCK_NONE = 0xFFFF;
+
+struct LacrosseHistoryPoint {
+  uint8_t family;
+  uint8_t address;
+  uint8_t type;
+  char quantity;
+  uint32_t timestamp_ms;
+  float value;
+};
+
+class LacrosseHistory {
+ public:
+  using point_callback_t = std::function<void(const LacrosseHistoryPoint &point)>;
+  using writer_t = std::function<void(const uint8_t *data, size_t len)>;
+
+  /// Memory of the blocks and of the series table (a series per 2 blocks, up to HISTORY_SERIES_MAX),
+  /// allocated here and the history cleared: 0 disables the history
+  void set_budget(size_t bytes);
+  bool is_enabled() const { return this->blocks_count_ > 0; }
+
+  void append(uint8_t family, uint8_t address, uint8_t type, char quantity, uint32_t now_ms, float value);
+
+  /// Readings of a sensor (all its quantities) from from_ms to to_ms included, oldest first
+  size_t query(uint8_t family, uint8_t address, uint8_t type, uint32_t from_ms, uint32_t to_ms,
+               const point_callback_t &callback) const;
+  /// All the readings as telemetry records (quality 0), in writes of up to DRAIN_RECORDS records,
+  /// then clears the history. Returns the number of readings.
+  size_t drain(const writer_t &writer);
+  void clear();
+
+  size_t get_budget() const {
+    return size_t(this->blocks_count_) * HISTORY_BLOCK_SIZE + this->series_max_ * sizeof(Series);
+  }
+  /// Blocks in use and series table
+  size_t get_memory_used() const {
+    return size_t(this->blocks_used_) * HISTORY_BLOCK_SIZE + this->series_max_ * sizeof(Series);
+  }
+  /// Sensors quantities the history can keep, a TX3 sensor using 2 and a WS7000-20 3
+  uint16_t get_series_max() const { return this->series_max_; }
+  /// Readings held
+  uint32_t get_readings() const { return this->readings_; }
+  /// Readings lost when their block was recycled, or without room for a new series
+  uint32_t get_dropped() const { return this->dropped_; }
+
+  static const uint8_t DRAIN_RECORDS = 32;
+
+ protected:
+  struct Block {
+    uint32_t start_tick;   // first reading, in full
+    int32_t start_value;
+    int16_t start_delta;   // ticks since the previous reading of the series, base of the first delta of delta
+    uint16_t next;         // next block of the series
+    uint8_t count;         // readings
+    uint8_t used;          // payload bytes
+    uint8_t payload[HISTORY_BLOCK_SIZE - 14];
+  };
+  struct Series {
+    uint8_t family;
+    uint8_t address;
+    uint8_t type;
+    char quantity;
+    uint16_t head;        // oldest block
+    uint16_t tail;        // block appended to
+    uint32_t last_tick;
+    int32_t last_delta;
+    int32_t last_value;
+  };
+
+  uint16_t allocate_();
+  void recycle_oldest_();
+  template<typename F> void decode_(const Series &series, F &&callback) const;
+
+  std::unique_ptr<Block[]> blocks_{};
+  uint16_t blocks_count_{0};
+  uint16_t blocks_used_{0};
+  uint16_t free_{HISTORY_BLOCK_NONE};  // free list, chained by next
+  std::unique_ptr<Series[]> series_{};  // allocated with the blocks
+  uint16_t series_max_{0};
+  uint16_t series_count_{0};
+  uint32_t readings_{0};
+  uint32_t dropped_{0};
+};
+
+}  // namespace remote_base
+}  // namespace esphome
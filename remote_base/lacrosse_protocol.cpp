@@ -1,6 +1,16 @@
 #include "lacrosse_protocol.h"
+#ifndef USE_REMOTE_BASE_HOST
+#include "esphome/core/defines.h"
 #include "esphome/core/log.h"
+#endif
 #include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+// built only when the configuration uses the protocol, see use_protocol() in __init__.py
+#if defined(USE_REMOTE_BASE_LACROSSE) || defined(USE_REMOTE_BASE_HOST)
 
 namespace esphome {
 
@@ -24,7 +34,11 @@ static const uint32_t WS7K_LONG_US = 800;
 
 static const uint8_t ERROR_PROTOCOL = 0xFF;
 
-static const uint8_t SENSORS_MAX = 30;
+static const uint32_t BIT_DISTANCE_MAX = 1000; // per mille, beyond it a pulses pair is not a bit at all
+static const uint8_t QUALITY_MIN = 30;         // per cent, average confidence of the bits of a frame
+static const uint8_t BIT_CONFIDENCE_MIN = 48;  // out of 255, weakest bit of a frame: a 4 bits checksum cannot catch all the bits flipped by a heavy jitter
+
+static const uint8_t COLLISION_PAIRS_MIN = 10; // pulses pairs of each family to suspect a collision
 
 // Protocols
 
@@ -34,6 +48,7 @@ static const uint8_t TX_START_SEQUENCE = 0x0A;
 
 static const char MEASURE_TEMPERATURE    = '0';
 static const char MEASURE_HUMIDITY       = 'E';
+static const char MEASURE_PRESSION       = 'P';
 static const char MEASURE_BRIGHTNESS     = 'L';
 static const char MEASURE_EXPOSITION     = 'X';
 static const char MEASURE_RAIN           = 'R';
@@ -42,23 +57,406 @@ static const char MEASURE_WIND_DIRECTION = 'D';
 
 // 
 
+LacrosseFilter global_lacrosse_filter;
+
+LacrosseState &LacrosseProtocol::global_state() {
+  static LacrosseState state{};
+  return state;
+}
+
+// === Measures and binary telemetry
+
+static void setMeasure(LacrosseData &out, uint8_t index, char quantity, float value) {
+  out.measures[index] = LacrosseMeasure{
+    .family = out.family,
+    .address = out.address,
+    .type = out.type,
+    .quantity = quantity,
+    .value = value,
+  };
+}
+
+LacrosseTelemetry &LacrosseProtocol::telemetry() {
+  static LacrosseTelemetry telemetry;
+  return telemetry;
+}
+
+void LacrosseTelemetry::write(const LacrosseData &data, uint32_t timestamp_ms) {
+  uint8_t aRecords[LACROSSE_MEASURES_MAX * LACROSSE_RECORD_SIZE];
+  const uint8_t iMeasures = std::min(data.iMeasures, LACROSSE_MEASURES_MAX);
+  for (uint8_t iMeasure = 0; iMeasure < iMeasures; iMeasure++) {
+    const LacrosseMeasure &measure = data.measures[iMeasure];
+    lacrosse_record_encode(LacrosseRecord{
+      .family = measure.family,
+      .address = measure.address,
+      .type = measure.type,
+      .quantity = measure.quantity,
+      .quality = data.quality,
+      .value_centi = lacrosse_fixed_point(measure.value, 100),
+      .timestamp_ms = timestamp_ms,
+    }, aRecords + iMeasure * LACROSSE_RECORD_SIZE);
+  }
+  this->writer_(aRecords, iMeasures * LACROSSE_RECORD_SIZE);
+  this->records_ += iMeasures;
+}
+
+void LacrosseLatency::record(const LacrosseTrace &trace, bool bCached) {
+  if (trace.first_edge_us != 0 && trace.frame_close_us != 0)
+    this->capture.record(trace.frame_close_us - trace.first_edge_us);
+  if (trace.frame_close_us != 0)
+    this->queue.record(trace.decode_start_us - trace.frame_close_us);
+  const uint32_t dedupe_us = trace.dedupe_us != 0 ? trace.dedupe_us : trace.decode_end_us;
+  if (!bCached)
+    this->decode.record(dedupe_us - trace.decode_start_us);
+  this->dedupe.record(trace.decode_end_us - dedupe_us);
+}
+
+void LacrosseLatency::pending(uint8_t family, uint8_t address, uint32_t decode_end_us) {
+  for (Pending &pending : this->pending_) {
+    if (pending.decode_end_us != 0 && pending.family == family && pending.address == address) {
+      pending.decode_end_us = decode_end_us; // not published yet, the latest reading replaces it
+      return;
+    }
+  }
+  this->pending_[this->next_] = Pending{family, address, decode_end_us};
+  this->next_ = (this->next_ + 1) % PENDING_MAX;
+}
+
+void LacrosseLatency::record_publish(uint8_t family, uint8_t address, uint32_t now_us) {
+  for (Pending &pending : this->pending_) {
+    if (pending.decode_end_us != 0 && pending.family == family && pending.address == address) {
+      this->publish.record(now_us - pending.decode_end_us);
+      pending.decode_end_us = 0;
+      return;
+    }
+  }
+}
+
+// === Repeated frames
+//
+// Each pulse is quantized to the nearest timing of both protocols within the tolerance, the timings
+// 100 us apart sharing their class as the bits decoding hardly tells them apart, and to its power of
+// two otherwise: jittered captures of the same packet get the same FNV-1a hash.
+
+struct LacrosseTimingClass {
+  uint32_t width_us;
+  uint8_t iClass;
+};
+
+static const LacrosseTimingClass aTimingClasses[] = {
+  { WS7K_SHORT_US, 1 }, { TX3_BIT_ONE_HIGH_US, 1 }, { WS7K_LONG_US, 2 },
+  { TX3_BIT_ZERO_LOW_US, 3 }, { TX3_BIT_ONE_LOW_US, 3 }, { TX3_BIT_ZERO_HIGH_US, 4 },
+};
+
+static uint64_t iFrameHash(const RemoteReceiveData &src) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int32_t iPulse = 0; iPulse < src.size(); iPulse++) {
+    const int32_t pulse = src[iPulse];
+    const uint32_t width = std::abs(pulse);
+    uint8_t iClass = 0x10 + (width == 0 ? 0 : 32 - __builtin_clz(width));
+    uint32_t iNearest = UINT32_MAX;
+    for (const LacrosseTimingClass &timing : aTimingClasses) {
+      const uint32_t error = width > timing.width_us ? width - timing.width_us : timing.width_us - width;
+      if (error < iNearest && error * 100 <= timing.width_us * src.get_tolerance()) {
+        iNearest = error;
+        iClass = timing.iClass;
+      }
+    }
+    hash = (hash ^ (iClass | (pulse < 0 ? 0x80 : 0))) * 0x100000001b3ULL;
+  }
+  return hash != 0 ? hash : 1;
+}
+
+LacrosseCacheEntry *LacrosseFrameCache::find(uint64_t hash, uint16_t pulses, uint32_t now_ms, bool bCount) {
+  for (LacrosseCacheEntry &entry : this->entries_) {
+    if (entry.hash == hash && entry.pulses == pulses && now_ms - entry.seen_ms <= LACROSSE_CACHE_WINDOW_MS) {
+      entry.seen_ms = now_ms;
+      if (bCount)
+        this->hits_++;
+      return &entry;
+    }
+  }
+  if (bCount)
+    this->misses_++;
+  return nullptr;
+}
+
+void LacrosseFrameCache::store(const LacrosseCacheEntry &entry) {
+  LacrosseCacheEntry *victim = &this->entries_[0];
+  for (LacrosseCacheEntry &candidate : this->entries_) {
+    if (candidate.hash == entry.hash && candidate.pulses == entry.pulses) {
+      victim = &candidate;
+      break;
+    }
+    if (candidate.hash == 0 || entry.seen_ms - candidate.seen_ms > entry.seen_ms - victim->seen_ms)
+      victim = &candidate;
+    if (candidate.hash == 0)
+      break;
+  }
+  *victim = entry;
+}
+
+void LacrosseProtocol::cacheStore(const LacrosseData &out) {
+  if (this->hash_ == 0)
+    return;
+  LacrosseCacheEntry entry{
+    .hash = this->hash_,
+    .seen_ms = this->now_ms_,
+    .pulses = this->pulses_,
+    .family = out.family,
+    .address = out.address,
+    .type = out.type,
+    .iMeasures = std::min(out.iMeasures, LACROSSE_CACHE_MEASURES),
+    .value = out.value,
+  };
+  for (uint8_t iMeasure = 0; iMeasure < entry.iMeasures; iMeasure++) {
+    entry.quantities[iMeasure] = out.measures[iMeasure].quantity;
+    entry.values[iMeasure] = out.measures[iMeasure].value;
+  }
+  this->state_->cache.store(entry);
+}
+
 optional<LacrosseData> LacrosseProtocol::decode(RemoteReceiveData src) {
-  if (bIsTx3Protocol(src)) {
+  return this->decode(src, millis());
+}
+
+optional<LacrosseData> LacrosseProtocol::decode(RemoteReceiveData src, uint32_t now_ms) {
+  this->now_ms_ = now_ms;
+  this->decoded_ = false;
+  this->filtered_ = false;
+  this->cached_ = false;
+  this->trace_ = LacrosseTrace{};
+  this->trace_.decode_start_us = micros();
+  if (src.get_timestamps() != nullptr) {
+    this->trace_.first_edge_us = src.get_timestamps()->first_edge_us;
+    this->trace_.frame_close_us = src.get_timestamps()->frame_close_us;
+  }
+
+  // try first the family of the sensor expected now - TX3 first when nobody is expected
+
+  LacrosseScheduler &schedule = this->state_->scheduler;
+  const bool bWsFirst = schedule.preferred_family(this->now_ms_) == LACROSSE_FAMILY_WS;
+
+  // the listeners and dumpers all decode the same frame: its close time tells the first one (0: unknown)
+  this->pulses_ = std::min<int32_t>(src.size(), UINT16_MAX);
+  const uint32_t iCloseUs = this->trace_.frame_close_us;
+  this->first_decoder_ = iCloseUs == 0 || iCloseUs != this->state_->frame_close_us ||
+                         this->pulses_ != this->state_->frame_pulses;
+  this->state_->frame_close_us = iCloseUs;
+  this->state_->frame_pulses = this->pulses_;
+
+  uint8_t iFamily = LACROSSE_FAMILY_NONE;
+  if (bWsFirst && bIsWs7kProtocol(src)) {
+    ESP_LOGD(TAG, "WS protocol (expected)");
+    iFamily = LACROSSE_FAMILY_WS;
+  } else if (bIsTx3Protocol(src)) {
     ESP_LOGV(TAG, "TX protocol");
-    return LacrosseProtocol::decodeTx(src);
-  } else if (bIsWs7kProtocol(src)) {
+    iFamily = LACROSSE_FAMILY_TX;
+  } else if (!bWsFirst && bIsWs7kProtocol(src)) {
     ESP_LOGD(TAG, "WS protocol");
-    return LacrosseProtocol::decodeWs(src);
-  } 
-  return {};
+    iFamily = LACROSSE_FAMILY_WS;
+  }
+
+  // only the frames with a valid header are hashed and looked up: noise is rejected in a few pulses
+
+  this->hash_ = 0;
+  optional<LacrosseData> res{};
+  if (iFamily != LACROSSE_FAMILY_NONE) {
+    this->hash_ = iFrameHash(src);
+    LacrosseFrameCache &cache = this->state_->cache;
+    LacrosseCacheEntry *entry = cache.find(this->hash_, this->pulses_, this->now_ms_, this->first_decoder_);
+    if (entry != nullptr) {
+      ESP_LOGV(TAG, "Repeated frame");
+      res = this->replay(*entry);
+    } else if (iFamily == LACROSSE_FAMILY_WS) {
+      res = LacrosseProtocol::decodeWs(src);
+    } else {
+      res = LacrosseProtocol::decodeTx(src);
+    }
+  }
+
+  if (!this->decoded_ && !this->filtered_ && src.size() >= 4 * COLLISION_PAIRS_MIN) {
+    this->hash_ = 0; // the frames out of a collision are not cached
+    res = LacrosseProtocol::decodeCollision(src);
+  }
+
+  if (this->filtered_ && !this->decoded_) {
+    this->state_->filtered++; // neither decoded nor failed: a sensor of the neighbours
+    return res;
+  }
+  if (!this->decoded_) {
+    schedule.frame_failed(this->now_ms_);
+    return res;
+  }
+
+  this->trace_.decode_end_us = micros();
+  if (this->first_decoder_) // the next decoders would count the frame again, their queue after the first ones
+    this->state_->latency.record(this->trace_, this->cached_);
+  if (res.has_value()) {
+    res->trace = this->trace_;
+    if (this->first_decoder_)
+      this->state_->latency.pending(res->family, res->address, this->trace_.decode_end_us);
+    if (this->first_decoder_ && LacrosseProtocol::telemetry().is_enabled()) // WS readings are not deduplicated
+      LacrosseProtocol::telemetry().write(*res, this->now_ms_);
+  }
+  return res;
 }
 
-optional<LacrosseData> LacrosseProtocol::decodeTx(RemoteReceiveData src) {
+// relative distance (per mille) of a pulse or of a pulses pair to the expected timings
+
+static uint32_t iPulseDistance(int32_t pulse, uint32_t pulse_us) {
+  return std::min<uint64_t>(std::abs(int64_t(pulse) - pulse_us) * 1000 / pulse_us, UINT16_MAX);
+}
+
+static uint32_t iPairDistance(int32_t mark, int32_t space, uint32_t mark_us, uint32_t space_us) {
+  return iPulseDistance(mark, mark_us) + iPulseDistance(space, space_us);
+}
+
+// what the decoding of the frame did, without reading the bits again
+
+optional<LacrosseData> LacrosseProtocol::replay(const LacrosseCacheEntry &entry) {
+  this->cached_ = true;
+  LacrosseData out{
+    .iMeasures = 0,
+    .address = entry.address,
+    .type = entry.type,
+    .value = entry.value,
+    .quality = 0, // not measured: the bits were not read
+    .family = entry.family,
+    .cached = true,
+  };
+  this->observe(out.family, out.address, out.type);
+  if (out.family == LACROSSE_FAMILY_TX) {
+    this->recordHistory(LACROSSE_FAMILY_TX, out.address, out.type, out.type==0 ? MEASURE_TEMPERATURE : MEASURE_HUMIDITY, out.value);
+    return this->dedupeTx(out);
+  }
+  size_t iLen = 0;
+  for (; out.iMeasures < entry.iMeasures; out.iMeasures++) {
+    const uint8_t iMeasure = out.iMeasures;
+    setMeasure(out, iMeasure, entry.quantities[iMeasure], entry.values[iMeasure]);
+    iLen += snprintf(out.buf + iLen, sizeof(out.buf) - iLen, "%sWS%01X%01X%c=%.1f", iMeasure==0 ? "" : ";",
+                     out.address, out.type, entry.quantities[iMeasure], entry.values[iMeasure]);
+    iLen = std::min(iLen, sizeof(out.buf) - 1);
+  }
+  this->recordMeasures(out);
+  return out;
+}
+
+// === Overlapping transmissions
+//
+// TX3 and WS7000 pulses pairs have clearly different widths: each pair is sent to the stream
+// of the family it fits, marks without a matching space (last TX3 bit) go with their family,
+// anything else is dropped as noise.
+
+bool LacrosseProtocol::bSeparateCollision(RemoteReceiveData src) {
+  LacrosseCollisions &collisions = this->state_->collisions;
+  collisions.tx.clear();
+  collisions.ws.clear();
+
+  uint32_t iTxPairs = 0;
+  uint32_t iWsPairs = 0;
+  while (int32_t(src.get_index()) + 1 < src.size()) {
+    if (src.peek() < 0) { // resync on a mark
+      src.advance();
+      continue;
+    }
+    // a WS7000 short/long pair also fits a TX3 one at large tolerances: keep the nearest family
+    const bool bTx = src.peek_item(TX3_BIT_ONE_HIGH_US, TX3_BIT_ONE_LOW_US) || src.peek_item(TX3_BIT_ZERO_HIGH_US, TX3_BIT_ZERO_LOW_US);
+    const bool bWs = src.peek_item(WS7K_SHORT_US, WS7K_LONG_US) || src.peek_item(WS7K_LONG_US, WS7K_SHORT_US);
+    std::vector<int32_t> *stream = nullptr;
+    if (bTx && bWs) {
+      const int32_t mark = src.peek();
+      const int32_t space = -src.peek(1);
+      const uint32_t iTxDistance = std::min(iPairDistance(mark, space, TX3_BIT_ONE_HIGH_US, TX3_BIT_ONE_LOW_US),
+                                            iPairDistance(mark, space, TX3_BIT_ZERO_HIGH_US, TX3_BIT_ZERO_LOW_US));
+      const uint32_t iWsDistance = std::min(iPairDistance(mark, space, WS7K_SHORT_US, WS7K_LONG_US),
+                                            iPairDistance(mark, space, WS7K_LONG_US, WS7K_SHORT_US));
+      stream = iTxDistance <= iWsDistance ? &collisions.tx : &collisions.ws;
+    } else if (bTx) {
+      stream = &collisions.tx;
+    } else if (bWs) {
+      stream = &collisions.ws;
+    } else if (src.peek_mark(TX3_BIT_ZERO_HIGH_US) || (src.peek_mark(TX3_BIT_ONE_HIGH_US) && !src.peek_mark(WS7K_SHORT_US))) {
+      stream = &collisions.tx;
+    } else {
+      src.advance();
+      continue;
+    }
+    if (stream == &collisions.tx) {
+      iTxPairs++;
+    } else {
+      iWsPairs++;
+    }
+    stream->push_back(src.peek());
+    stream->push_back(src.peek(1));
+    src.advance(2);
+  }
+  return iTxPairs >= COLLISION_PAIRS_MIN && iWsPairs >= COLLISION_PAIRS_MIN;
+}
 
-  // keep track of already seen sensors
+optional<LacrosseData> LacrosseProtocol::decodeCollision(RemoteReceiveData src) {
+  if (!bSeparateCollision(src))
+    return {};
 
-  static uint8_t iSensors = 0;  
-  static LacrosseDataStore aSensors[SENSORS_MAX];
+  LacrosseCollisions &collisions = this->state_->collisions;
+  collisions.detected++;
+  ESP_LOGD(TAG, "Collision: %zu TX and %zu WS pulses", collisions.tx.size(), collisions.ws.size());
+
+  optional<LacrosseData> tx{};
+  RemoteReceiveData tx_src(&collisions.tx, src.get_tolerance());
+  if (bIsTx3Protocol(tx_src))
+    tx = LacrosseProtocol::decodeTx(tx_src);
+  const bool bTxDecoded = this->decoded_;
+  const bool bTxFiltered = this->filtered_;
+  this->decoded_ = false;
+  this->filtered_ = false;
+
+  optional<LacrosseData> ws{};
+  RemoteReceiveData ws_src(&collisions.ws, src.get_tolerance());
+  if (bIsWs7kProtocol(ws_src))
+    ws = LacrosseProtocol::decodeWs(ws_src);
+  const bool bWsDecoded = this->decoded_;
+  const bool bWsFiltered = this->filtered_;
+
+  this->decoded_ = bTxDecoded || bWsDecoded;
+  this->filtered_ = bTxFiltered || bWsFiltered;
+  collisions.recovered += bTxDecoded + bWsDecoded;
+  collisions.lost += (!bTxDecoded && !bTxFiltered) + (!bWsDecoded && !bWsFiltered);
+
+  if (tx.has_value() && ws.has_value()) { // send back the measures of both transmissions
+    for (uint8_t iMeasure = 0; iMeasure < ws->iMeasures && tx->iMeasures < LACROSSE_MEASURES_MAX; iMeasure++)
+      tx->measures[tx->iMeasures++] = ws->measures[iMeasure];
+    size_t len = strlen(tx->buf);
+    snprintf(tx->buf + len, sizeof(tx->buf) - len, ";%s", ws->buf);
+    return tx;
+  }
+  return tx.has_value() ? tx : ws;
+}
+
+void LacrosseProtocol::observe(uint8_t family, uint8_t address, uint8_t type) {
+  this->decoded_ = true;
+  this->arrival_ = this->state_->scheduler.observe(family, address, type, this->now_ms_);
+  if (this->arrival_ == ARRIVAL_UNEXPECTED) {
+    ESP_LOGD(TAG, "%s%02X%01X arrived outside of its window", family == LACROSSE_FAMILY_TX ? "TX" : "WS", address,
+             type);
+  }
+}
+
+// every reading goes to the history, unchanged values included - not the repeated packets
+
+void LacrosseProtocol::recordHistory(uint8_t family, uint8_t address, uint8_t type, char quantity, float value) {
+  if (this->arrival_ != ARRIVAL_REPEAT)
+    this->state_->history.append(family, address, type, quantity, this->now_ms_, value);
+}
+
+void LacrosseProtocol::recordMeasures(const LacrosseData &out) {
+  for (uint8_t iMeasure = 0; iMeasure < out.iMeasures; iMeasure++) {
+    const LacrosseMeasure &measure = out.measures[iMeasure];
+    this->recordHistory(measure.family, measure.address, measure.type, measure.quantity, measure.value);
+  }
+}
+
+optional<LacrosseData> LacrosseProtocol::decodeTx(RemoteReceiveData src) {
 
   uint64_t packet = 0;
   LacrosseData out{
@@ -69,6 +467,8 @@ optional<LacrosseData> LacrosseProtocol::decodeTx(RemoteReceiveData src) {
   };
 
   src.advance(8*2); // header already checked by bIsTx3Protocol
+  out.family = LACROSSE_FAMILY_TX;
+  this->resetQuality();
 
   out.type = this->readNibble(src);
   if (out.type==0xff) {
@@ -97,6 +497,12 @@ optional<LacrosseData> LacrosseProtocol::decodeTx(RemoteReceiveData src) {
 
   out.address = add_msb << 3 | (add_lsb & 0xE) >> 1;
 
+  if (!global_lacrosse_filter.is_accepted(LACROSSE_FAMILY_TX, out.address, out.type)) {
+    ESP_LOGV(TAG, "TX%02X%01X not configured", out.address, out.type );
+    this->filtered_ = true; // the digits and the checksum are not decoded
+    return {};
+  }
+
   // Let's decode the digits
 
   uint8_t iNumDigits;
@@ -143,43 +549,79 @@ optional<LacrosseData> LacrosseProtocol::decodeTx(RemoteReceiveData src) {
     return {};
   }
 
+  out.quality = this->iQuality();
+  if (out.quality<QUALITY_MIN) {
+    ESP_LOGD( TAG, "Low quality frame for sensor %02X (%d%%)", out.address, out.quality );
+    return {};
+  }
+  if (this->iConfidenceMin_<BIT_CONFIDENCE_MIN) {
+    ESP_LOGD( TAG, "Ambiguous bit in frame for sensor %02X (%d/255)", out.address, this->iConfidenceMin_ );
+    return {};
+  }
+
+
   if (aDigits[0]==aDigits[3] && aDigits[1]==aDigits[4]) {
+    this->observe(LACROSSE_FAMILY_TX, out.address, out.type);
+
     if (out.type==0) { // temperature
       out.value = 10.0*aDigits[0] + aDigits[1] - 50.0 + (0.0+aDigits[2])/10;
     } else {
       out.value = 10.0*aDigits[0] + aDigits[1]  + (0.0+aDigits[2])/10;
     }
+    this->recordHistory(LACROSSE_FAMILY_TX, out.address, out.type, out.type==0 ? MEASURE_TEMPERATURE : MEASURE_HUMIDITY, out.value);
 
-    // look for a free slot
+    this->cacheStore(out);
+    return this->dedupeTx(out);
+  }
+  return {};
+}
 
-    uint8_t iSameSlot = 0xff;
-    for (uint8_t iSlot = 0; iSlot < SENSORS_MAX; iSlot++) { 
-      if (out.address==aSensors[iSlot].address && out.type==aSensors[iSlot].type) {
-        iSameSlot = iSlot;
-        break;
-      }
+// keep track of already seen sensors: only their new values are returned
+
+optional<LacrosseData> LacrosseProtocol::dedupeTx(LacrosseData &out) {
+  uint8_t &iSensors = this->state_->iSensors;
+  LacrosseDataStore *aSensors = this->state_->sensors;
+
+  // look for a free slot
+
+  this->trace_.dedupe_us = micros();
+
+  uint8_t iSameSlot = 0xff;
+  for (uint8_t iSlot = 0; iSlot < iSensors; iSlot++) { 
+    if (out.address==aSensors[iSlot].address && out.type==aSensors[iSlot].type) {
+      iSameSlot = iSlot;
+      break;
     }
+  }
 
-    if (iSameSlot==0xff) { // first time we see this sensor
-      iSameSlot=iSensors;
-      aSensors[iSameSlot].address = out.address; 
-      aSensors[iSameSlot].type = out.type; 
-      aSensors[iSameSlot].value = out.value; 
-      iSensors++;
+  if (iSameSlot==0xff && iSensors==LACROSSE_SENSORS_MAX) { // no room left, not deduplicated
+    out.iMeasures = 1;
+    setMeasure(out, 0, out.type==0 ? MEASURE_TEMPERATURE : MEASURE_HUMIDITY, out.value);
+    sprintf(out.buf, "TX%02X%01X=%.1f", out.address, out.type, out.value );
+    return out;
+  } else if (iSameSlot==0xff) { // first time we see this sensor
+    iSameSlot=iSensors;
+    aSensors[iSameSlot].address = out.address; 
+    aSensors[iSameSlot].type = out.type; 
+    aSensors[iSameSlot].value = out.value; 
+    aSensors[iSameSlot].quality = out.quality; 
+    iSensors++;
+    out.iMeasures = 1;
+    setMeasure(out, 0, out.type==0 ? MEASURE_TEMPERATURE : MEASURE_HUMIDITY, out.value);
+    sprintf(out.buf, "TX%02X%01X=%.1f", out.address, out.type, out.value );
+    ESP_LOGD(TAG, "NEW %s", out.buf );
+    return out;
+  } else if (iSameSlot!=0xff) { // sensor known
+    if (!out.cached)
+      aSensors[iSameSlot].quality = ( 3*aSensors[iSameSlot].quality + out.quality ) / 4; // link quality
+    if (aSensors[iSameSlot].value!=out.value) { // if new value
       out.iMeasures = 1;
+      setMeasure(out, 0, out.type==0 ? MEASURE_TEMPERATURE : MEASURE_HUMIDITY, out.value);
       sprintf(out.buf, "TX%02X%01X=%.1f", out.address, out.type, out.value );
-      ESP_LOGD(TAG, "NEW %s", out.buf );
+      ESP_LOGD(TAG, "UPD %s", out.buf );
+      aSensors[iSameSlot].value=out.value;
       return out;
-    } else if (iSameSlot!=0xff) { // sensor known
-      if (aSensors[iSameSlot].value!=out.value) { // if new value
-        out.iMeasures = 1;
-        sprintf(out.buf, "TX%02X%01X=%.1f", out.address, out.type, out.value );
-        ESP_LOGD(TAG, "UPD %s", out.buf );
-        aSensors[iSameSlot].value=out.value;
-        return out;
-      }
     }
-    return {};
   }
   return {};
 }
@@ -195,6 +637,8 @@ optional<LacrosseData> LacrosseProtocol::decodeWs(RemoteReceiveData src) {
   };
 
   src.advance(10*2); // header already checked by bIsTx3Protocol
+  out.family = LACROSSE_FAMILY_WS;
+  this->resetQuality();
 
   out.type = this->readWsNibble(src);
   if (out.type==0xff) {
@@ -206,6 +650,12 @@ optional<LacrosseData> LacrosseProtocol::decodeWs(RemoteReceiveData src) {
     return {};
   }
 
+  if (!global_lacrosse_filter.is_accepted(LACROSSE_FAMILY_WS, out.address, out.type)) {
+    ESP_LOGV(TAG, "WS%01X%01X not configured", out.address, out.type );
+    this->filtered_ = true; // the digits and the checksums are not decoded
+    return {};
+  }
+
   uint8_t iNumDigits;
   uint8_t aDigits[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }; // 10 next nibbles are digits in BCD
 
@@ -243,6 +693,10 @@ optional<LacrosseData> LacrosseProtocol::decodeWs(RemoteReceiveData src) {
      iNumDigits = 7;
      break;
 
+    default: // types 6..15: the digits count is not known, the frame cannot be checked
+     ESP_LOGV(TAG, "Not supported WS sensor (type %01X)", out.type );
+     return {};
+
   }
 
   uint8_t iComputeXor =       out.type ^ out.address;
@@ -282,6 +736,19 @@ optional<LacrosseData> LacrosseProtocol::decodeWs(RemoteReceiveData src) {
    return {};
   }
 
+  out.quality = this->iQuality();
+  if (out.quality<QUALITY_MIN) {
+    ESP_LOGD( TAG, "Low quality frame for sensor %01X (%d%%)", out.address, out.quality );
+    return {};
+  }
+  if (this->iConfidenceMin_<BIT_CONFIDENCE_MIN) {
+    ESP_LOGD( TAG, "Ambiguous bit in frame for sensor %01X (%d/255)", out.address, this->iConfidenceMin_ );
+    return {};
+  }
+
+  // one schedule slot per sensor: the WS7000-20 temperature sign (address bit 3) is not part of its address
+  this->observe(LACROSSE_FAMILY_WS, out.type == 4 ? out.address & 0x7 : out.address, out.type);
+
   // float aValues[] = { 0, 0, 0 };
 
   switch (out.type) {
@@ -294,15 +761,18 @@ optional<LacrosseData> LacrosseProtocol::decodeWs(RemoteReceiveData src) {
       }
 
     case 2: {// WS7000-16 rain sensor
-        float fVolume = aDigits[2]<<8 + aDigits[1]<<4 + aDigits[0];
+        float fVolume = (aDigits[2]<<8) + (aDigits[1]<<4) + aDigits[0];
         sprintf(out.buf, "WS%01X%01XR=%.1f", out.address, out.type, fVolume );
+        setMeasure(out, 0, MEASURE_RAIN, fVolume);
         out.iMeasures = 1;
         break;
       }
     case 3: { // WS7000-15 wind sensor - 10 blocks
         float fSpeed     = 10*aDigits[2] + aDigits[1] + ( 0.0 + aDigits[0] )/10;
-        float fDirection = 0;
-        out.iMeasures = 2;
+        float fDirection = 0; // not decoded yet
+        sprintf(out.buf, "WS%01X%01XS=%.1f", out.address, out.type, fSpeed );
+        setMeasure(out, 0, MEASURE_WIND_SPEED, fSpeed);
+        out.iMeasures = 1;
         break;
       }
 
@@ -319,15 +789,19 @@ optional<LacrosseData> LacrosseProtocol::decodeWs(RemoteReceiveData src) {
         ESP_LOGV( TAG, "Temperature: %f", fTemperature );
         // send back the three sensors values - 
         out.iMeasures = 3;
+        setMeasure(out, 0, MEASURE_PRESSION, fPression);
+        setMeasure(out, 1, MEASURE_TEMPERATURE, fTemperature);
+        setMeasure(out, 2, MEASURE_HUMIDITY, fHumidity);
         sprintf(out.buf, "WS%01X%01XP=%.1f;WS%01X%01X0=%.1f;WS%01X%01XE=%.1f", out.address, out.type, fPression, out.address, out.type, fTemperature, out.address, out.type,fHumidity );
         break;
       }
 
     case 5: { // WS2500-19 - 11 blocks - 9 remaining - 7 digits - XOR - SUM
         float fbrightness = (aDigits[2]*100 + aDigits[1]*10 + aDigits[0])*exp10(aDigits[3]);
-        float fexposition =  aDigits[6]<<8 + aDigits[5]<<4 + aDigits[4];
+        float fexposition =  (aDigits[6]<<8) + (aDigits[5]<<4) + aDigits[4];
         out.iMeasures = 1;
         sprintf(out.buf, "WS%01X%01XL=%.1f", out.address, out.type, fbrightness );
+        setMeasure(out, 0, MEASURE_BRIGHTNESS, fbrightness);
 //        sprintf(out.buf, "WS%01X%01XL=%.1f;WS%01X%01XX=%.1f", out.address, out.type, fbrightbess, out.address, out.type, fexposition );
         break; 
       }
@@ -336,40 +810,155 @@ optional<LacrosseData> LacrosseProtocol::decodeWs(RemoteReceiveData src) {
 
   if (out.iMeasures>0) {
     ESP_LOGD(TAG, "Measures %s", out.buf );
+    this->recordMeasures(out);
+    this->cacheStore(out);
     return out;
   } else {
     return {};
   }
 }
 
+// === Transmission, TX3 only
+//
+// nibbles sent most significant bit first: header 0 A, type, address (7 bits) and a parity bit,
+// 5 BCD digits (the 2 first ones repeated), checksum
+
+static const uint8_t TX3_NIBBLES = 11;
+
+static bool bTx3Nibbles(const LacrosseData &data, uint8_t *aNibbles) {
+  if (data.family != LACROSSE_FAMILY_TX || (data.type != 0x0 && data.type != 0xE) || data.address > 0x7F) {
+    ESP_LOGW(TAG, "Only TX3 temperature and humidity readings can be sent");
+    return false;
+  }
+  const long iTenths = lroundf((data.type == 0 ? data.value + 50 : data.value) * 10);
+  if (iTenths < 0 || iTenths > 999) {
+    ESP_LOGW(TAG, "Value %.1f out of the TX3 range", data.value);
+    return false;
+  }
+  const uint8_t aDigits[] = { uint8_t(iTenths / 100), uint8_t(iTenths / 10 % 10), uint8_t(iTenths % 10) };
+  const uint8_t iParity = __builtin_parity(aDigits[0] << 8 | aDigits[1] << 4 | aDigits[2]); // even, not checked by the decoder
+
+  aNibbles[0] = TX_START_SEQUENCE >> 4;
+  aNibbles[1] = TX_START_SEQUENCE & 0xF;
+  aNibbles[2] = data.type;
+  aNibbles[3] = data.address >> 3;
+  aNibbles[4] = (data.address & 0x7) << 1 | iParity;
+  aNibbles[5] = aDigits[0];
+  aNibbles[6] = aDigits[1];
+  aNibbles[7] = aDigits[2];
+  aNibbles[8] = aDigits[0];
+  aNibbles[9] = aDigits[1];
+  uint8_t iSum = 0;
+  for (uint8_t iNibble = 0; iNibble < TX3_NIBBLES - 1; iNibble++)
+    iSum += aNibbles[iNibble];
+  aNibbles[10] = iSum & 0xF;
+  return true;
+}
+
 void LacrosseProtocol::encode(RemoteTransmitData *dst, const LacrosseData &data) {
+  uint8_t aNibbles[TX3_NIBBLES];
+  if (!bTx3Nibbles(data, aNibbles))
+    return;
+  dst->reserve(TX3_NIBBLES * 4 * 2);
+  for (uint8_t iBit = 0; iBit < TX3_NIBBLES * 4; iBit++) {
+    if (aNibbles[iBit / 4] & (0x8 >> iBit % 4)) {
+      dst->item(TX3_BIT_ONE_HIGH_US, TX3_BIT_ONE_LOW_US);
+    } else {
+      dst->item(TX3_BIT_ZERO_HIGH_US, TX3_BIT_ZERO_LOW_US);
+    }
+  }
+}
+
+void LacrosseProtocol::encode(RemoteTransmitItems *dst, const LacrosseData &data) {
+  uint8_t aNibbles[TX3_NIBBLES];
+  if (!bTx3Nibbles(data, aNibbles))
+    return;
+  if (dst->to_ticks(TX3_BIT_ZERO_HIGH_US) > RemoteTransmitItems::DURATION_MAX) { // fast clock: pulses split
+    for (uint8_t iBit = 0; iBit < TX3_NIBBLES * 4; iBit++) {
+      if (aNibbles[iBit / 4] & (0x8 >> iBit % 4)) {
+        dst->item(TX3_BIT_ONE_HIGH_US, TX3_BIT_ONE_LOW_US);
+      } else {
+        dst->item(TX3_BIT_ZERO_HIGH_US, TX3_BIT_ZERO_LOW_US);
+      }
+    }
+    return;
+  }
+  // the 2 bits converted to ticks once, then a 32 bits store per bit
+  const RemoteTransmitItem one = dst->make_item(TX3_BIT_ONE_HIGH_US, TX3_BIT_ONE_LOW_US);
+  const RemoteTransmitItem zero = dst->make_item(TX3_BIT_ZERO_HIGH_US, TX3_BIT_ZERO_LOW_US);
+  dst->reserve(TX3_NIBBLES * 4);
+  for (uint8_t iBit = 0; iBit < TX3_NIBBLES * 4; iBit++)
+    dst->push(aNibbles[iBit / 4] & (0x8 >> iBit % 4) ? one : zero);
 }
 
 void LacrosseProtocol::dump(const LacrosseData &data) {
   ESP_LOGD(TAG, "Received Lacrosse: type=%d  address=%d" PRIX8, data.type, data.address);
 }
 
+// === Nearest template bit classification
+//
+// Each pulses pair goes to the nearest of the two expected encodings, the margin between both
+// distances is the confidence of the bit. A single pulse out of the tolerance windows no longer
+// aborts the frame: the frame is rejected on its checksum, on its average confidence and on the
+// confidence of its weakest bit.
+
+int8_t LacrosseProtocol::readBit(RemoteReceiveData &src, uint32_t one_mark_us, uint32_t one_space_us,
+                                 uint32_t zero_mark_us, uint32_t zero_space_us, bool bMarkOnly) {
+  if (int32_t(src.get_index()) + (bMarkOnly ? 0 : 1) >= src.size())
+    return -1;
+  const int32_t mark = src.peek();
+  const int32_t space = bMarkOnly ? 0 : -src.peek(1);
+  if (mark <= 0 || space < 0)
+    return -1;
+
+  uint32_t iOneDistance;
+  uint32_t iZeroDistance;
+  if (bMarkOnly) { // the space of the last bit is the gap after the frame
+    iOneDistance = 2 * iPulseDistance(mark, one_mark_us);
+    iZeroDistance = 2 * iPulseDistance(mark, zero_mark_us);
+  } else {
+    iOneDistance = iPairDistance(mark, space, one_mark_us, one_space_us);
+    iZeroDistance = iPairDistance(mark, space, zero_mark_us, zero_space_us);
+  }
+  const uint32_t iNearest = std::min(iOneDistance, iZeroDistance);
+  if (iNearest > BIT_DISTANCE_MAX)
+    return -1;
+
+  const uint32_t iFarthest = std::max(iOneDistance, iZeroDistance);
+  const uint8_t iBitConfidence = (iFarthest - iNearest) * 255 / (iFarthest + iNearest);
+  this->iConfidence_ += iBitConfidence;
+  this->iConfidenceMin_ = std::min(this->iConfidenceMin_, iBitConfidence);
+  this->iBits_++;
+  src.advance(bMarkOnly ? 1 : 2);
+  return iOneDistance <= iZeroDistance ? 1 : 0;
+}
+
+void LacrosseProtocol::resetQuality() {
+  this->iConfidence_ = 0;
+  this->iConfidenceMin_ = UINT8_MAX;
+  this->iBits_ = 0;
+}
+
+uint8_t LacrosseProtocol::iQuality() const {
+  if (this->iBits_ == 0)
+    return 0;
+  return this->iConfidence_ * 100 / (255 * this->iBits_);
+}
+
 uint8_t LacrosseProtocol::readNibble(RemoteReceiveData &src, bool bUltimate) {
   uint8_t _nibble = 0;
   for (uint8_t bit_counter = 0; bit_counter < 4; bit_counter++) {
-    if (src.expect_item(TX3_BIT_ONE_HIGH_US, TX3_BIT_ONE_LOW_US)) {
-      _nibble = (_nibble << 1) | 1;
-    } else if (src.expect_item(TX3_BIT_ZERO_HIGH_US, TX3_BIT_ZERO_LOW_US)) {
-      _nibble = (_nibble << 1) | 0;
-    } else if (bUltimate && bit_counter==3) {
-      if (src.peek_mark(TX3_BIT_ONE_HIGH_US)) {
-        _nibble = (_nibble << 1) | 1;
-        ESP_LOGV( TAG, "ULTIMATE BIT 1 SAVED" );
-      } else if (src.peek_mark(TX3_BIT_ZERO_HIGH_US)) {
-        ESP_LOGV( TAG, "ULTIMATE BIT 0 SAVED" );
-        _nibble = (_nibble << 1) | 0;
-      } else {
-        return ERROR_PROTOCOL;
-      }
-    } else {
+    // special treatment for the last bit: its space is lost in the gap after the frame
+    const bool bMarkOnly = bUltimate && bit_counter==3 && !src.peek_space(TX3_BIT_ONE_LOW_US, 1) && !src.peek_space(TX3_BIT_ZERO_LOW_US, 1);
+    int8_t iBit = this->readBit(src, TX3_BIT_ONE_HIGH_US, TX3_BIT_ONE_LOW_US, TX3_BIT_ZERO_HIGH_US, TX3_BIT_ZERO_LOW_US, bMarkOnly);
+    if (iBit < 0) {
       ESP_LOGV( TAG, "TX not a bit (%d)", bit_counter );
       return ERROR_PROTOCOL;
     }
+    if (bMarkOnly) {
+      ESP_LOGV( TAG, "ULTIMATE BIT %d SAVED", iBit );
+    }
+    _nibble = (_nibble << 1) | iBit;
   }
   return _nibble;
 } 
@@ -409,17 +998,15 @@ bool LacrosseProtocol::bIsWs7kProtocol(RemoteReceiveData src) {
 }
 
 uint8_t LacrosseProtocol::readWsNibble(RemoteReceiveData &src) {
-  if (src.expect_item(WS7K_SHORT_US, WS7K_LONG_US)) {
+  if (this->readBit(src, WS7K_SHORT_US, WS7K_LONG_US, WS7K_LONG_US, WS7K_SHORT_US) == 1) {
     uint8_t _nibble = 0;
     for (uint8_t bit_counter = 0; bit_counter < 4; bit_counter++) {
-     if (src.expect_item(WS7K_SHORT_US, WS7K_LONG_US)) {
-        _nibble = (_nibble >> 1) | 8;
-      } else if (src.expect_item(WS7K_LONG_US, WS7K_SHORT_US)) {
-        _nibble = (_nibble >> 1) | 0;
-      } else {
+      int8_t iBit = this->readBit(src, WS7K_SHORT_US, WS7K_LONG_US, WS7K_LONG_US, WS7K_SHORT_US);
+      if (iBit < 0) {
         ESP_LOGD( TAG, "WS not a bit (%d)", bit_counter );
         return ERROR_PROTOCOL; // it was not a 1 neither a 0
       }
+      _nibble = (_nibble >> 1) | (iBit << 3);
     }
     return _nibble;
   }
@@ -430,3 +1017,5 @@ uint8_t LacrosseProtocol::readWsNibble(RemoteReceiveData &src) {
 
 }  // namespace remote_base
 }  // namespace esphome
+
+#endif  // USE_REMOTE_BASE_LACROSSE
@@ -1,12 +1,45 @@
 #pragma once
 
+#ifdef USE_REMOTE_BASE_HOST
+#include "remote_data.h"
+#else
 #include "esphome/core/component.h"
 #include "esphome/core/helpers.h"
 #include "remote_base.h"
+#endif
+#include "lacrosse_history.h"
+#include "lacrosse_scheduler.h"
+#include "latency_histogram.h"
+#include "lacrosse_telemetry.h"
+#include <functional>
 
 namespace esphome {
 namespace remote_base {
 
+// monotonic timestamps (micros) of a frame, from its first edge to the end of its decoding
+
+struct LacrosseTrace
+{
+    uint32_t first_edge_us;
+    uint32_t frame_close_us;
+    uint32_t decode_start_us;
+    uint32_t dedupe_us;
+    uint32_t decode_end_us;
+};
+
+// one physical quantity of a reading
+
+static const uint8_t LACROSSE_MEASURES_MAX = 4; // 3 for a WS7000-20, 4 for a TX3 and a WS7000-20 out of a collision
+
+struct LacrosseMeasure
+{
+    uint8_t family;
+    uint8_t address;
+    uint8_t type;
+    char quantity; // as in the buffer: '0' temperature, 'E' humidity, 'P' pression...
+    float value;
+};
+
 // for sending back an answer
 
 struct LacrosseData
@@ -15,48 +48,277 @@ struct LacrosseData
     uint8_t address;
     uint8_t type;
     float value;
+    uint8_t quality; // average confidence of the bits, per cent - 0 when cached
+    uint8_t family;
+    bool cached;     // replayed from the frame cache: the bits were not read, the quality not measured
+    LacrosseTrace trace;
+    LacrosseMeasure measures[LACROSSE_MEASURES_MAX];
     char buf[80];
     bool operator==(const LacrosseData &rhs) const { return type == rhs.type && address == rhs.address; }
 };
 
 // to keep record of previous sensors values
 
+static const uint8_t LACROSSE_SENSORS_MAX = 30;
+
 struct LacrosseDataStore
 {
     uint8_t address;
     uint8_t type;
     float value;
+    uint8_t quality; // link quality, per cent
+};
+
+// to split overlapping transmissions of both timing families
+
+struct LacrosseCollisions
+{
+    std::vector<int32_t> tx;  // pulses fitting the TX3 timings
+    std::vector<int32_t> ws;  // pulses fitting the WS7000 timings
+    uint32_t detected;
+    uint32_t recovered;       // transmissions decoded out of a collision
+    uint32_t lost;            // transmissions lost in a collision
+};
+
+// accept set of the sensors listed in the dumper configuration, checked right after the type and address nibbles:
+// the frames of the other sensors skip the digits and the checksum
+// a bit per (address, type): TX3 addresses are 7 bits, WS7000 addresses 3 bits (the 4th is a sign for type 4)
+
+class LacrosseFilter
+{
+ public:
+  void accept(uint8_t family, uint8_t address, uint8_t type) {
+    const uint16_t key = key_(family, address, type);
+    this->bits_[key >> 3] |= 1 << (key & 7);
+    this->enabled_ = true;
+  }
+  void accept_address(uint8_t family, uint8_t address) {
+    for (uint8_t type = 0; type < 16; type++)
+      this->accept(family, address, type);
+  }
+  /// Discovery mode lets all the frames through to find the addresses of new sensors
+  void set_discovery(bool discovery) { this->discovery_ = discovery; }
+
+  bool is_accepted(uint8_t family, uint8_t address, uint8_t type) const {
+    if (!this->enabled_ || this->discovery_)
+      return true;
+    const uint16_t key = key_(family, address, type);
+    return this->bits_[key >> 3] & (1 << (key & 7));
+  }
+
+ protected:
+  static uint16_t key_(uint8_t family, uint8_t address, uint8_t type) {
+    if (family == LACROSSE_FAMILY_TX)
+      return (address & 0x7F) << 4 | (type & 0xF);
+    return 0x800 | (address & 0x7) << 4 | (type & 0xF);
+  }
+
+  uint8_t bits_[(0x800 + 0x80) / 8]{};
+  bool enabled_{false};  // nothing configured: accept all
+  bool discovery_{false};
+};
+
+extern LacrosseFilter global_lacrosse_filter;
+
+// latency of each stage of the frames, from the first edge to the sensor publish
+
+class LacrosseLatency
+{
+ public:
+  /// Stages of a decoded frame - a cached one was not decoded, only its capture, queue and dedupe count
+  void record(const LacrosseTrace &trace, bool bCached = false);
+  /// A reading of the sensor is handed over to the sensor, to be published
+  void pending(uint8_t family, uint8_t address, uint32_t decode_end_us);
+  /// The sensor published its reading
+  void record_publish(uint8_t family, uint8_t address, uint32_t now_us);
+
+  LatencyHistogram capture;  // first edge -> frame close
+  LatencyHistogram queue;    // frame close -> decode start
+  LatencyHistogram decode;   // decode start -> dedupe decision
+  LatencyHistogram dedupe;   // dedupe decision -> decode end
+  LatencyHistogram publish;  // decode end -> publish_state
+
+ protected:
+  struct Pending {
+    uint8_t family;
+    uint8_t address;
+    uint32_t decode_end_us;
+  };
+  static const uint8_t PENDING_MAX = 8;
+  Pending pending_[PENDING_MAX]{};
+  uint8_t next_{0};
+};
+
+// recent frames, by hash of their pulses quantized to the protocol timings within the tolerance:
+// a repeated frame (same packet sent twice, same reading sent again) skips the bits decoding
+
+#ifndef LACROSSE_CACHE_SIZE
+#define LACROSSE_CACHE_SIZE 8
+#endif
+static const uint32_t LACROSSE_CACHE_WINDOW_MS = 300000; // a few transmission periods
+static const uint8_t LACROSSE_CACHE_MEASURES = 3; // a WS7000-20: the readings out of a collision are not cached
+
+// the reading of the frame, not its LacrosseData: the buffer is formatted again on a hit
+
+struct LacrosseCacheEntry
+{
+    uint64_t hash;            // 0: free
+    uint32_t seen_ms;
+    uint16_t pulses;
+    uint8_t family;
+    uint8_t address;
+    uint8_t type;
+    uint8_t iMeasures;        // TX3: 0, measured by the deduplication
+    float value;
+    char quantities[LACROSSE_CACHE_MEASURES];
+    float values[LACROSSE_CACHE_MEASURES];
+};
+
+class LacrosseFrameCache
+{
+ public:
+  /// Entry of the frame seen within LACROSSE_CACHE_WINDOW_MS, nullptr if none.
+  /// bCount: first lookup of the frame, the next listeners and dumpers decoding it are not counted
+  LacrosseCacheEntry *find(uint64_t hash, uint16_t pulses, uint32_t now_ms, bool bCount = true);
+  /// Replaces the entry of the same frame or the least recently seen one
+  void store(const LacrosseCacheEntry &entry);
+
+  uint32_t get_hits() const { return this->hits_; }
+  uint32_t get_misses() const { return this->misses_; }
+
+ protected:
+  LacrosseCacheEntry entries_[LACROSSE_CACHE_SIZE]{};
+  uint32_t hits_{0};
+  uint32_t misses_{0};
+};
+
+// decoding state of a stream of frames: each receiver (or each stream of the host daemon) has its own
+
+struct LacrosseState
+{
+    LacrosseDataStore sensors[LACROSSE_SENSORS_MAX];
+    uint8_t iSensors;
+    LacrosseScheduler scheduler;
+    LacrosseCollisions collisions;
+    LacrosseLatency latency;
+    LacrosseHistory history;    // disabled until a budget is set
+    LacrosseFrameCache cache;
+    uint32_t filtered;          // frames of addresses not configured, dropped before their checksum
+    uint32_t frame_close_us;    // last frame decoded, decoded again by the next listeners and dumpers
+    uint16_t frame_pulses;
+};
+
+// binary telemetry sink of the decoded readings, one record per measure - see lacrosse_telemetry.h
+
+class LacrosseTelemetry
+{
+ public:
+  using writer_t = std::function<void(const uint8_t *data, size_t len)>;
+
+  /// e.g. [](const uint8_t *data, size_t len) { id(uart_bus).write_array(data, len); }
+  void set_writer(writer_t &&writer) { this->writer_ = std::move(writer); }
+  bool is_enabled() const { return static_cast<bool>(this->writer_); }
+
+  void write(const LacrosseData &data, uint32_t timestamp_ms);
+
+  uint32_t get_records() const { return this->records_; }
+
+ protected:
+  writer_t writer_{};
+  uint32_t records_{0};
 };
 
 class LacrosseProtocol : public RemoteProtocol<LacrosseData> {
  public:
+  LacrosseProtocol() : state_(&LacrosseProtocol::global_state()) {}
+  explicit LacrosseProtocol(LacrosseState *state) : state_(state) {}
+
+  /// TX3 frame of the reading (family TX, type 0 or 0xE, address and value)
   void encode(RemoteTransmitData *dst, const LacrosseData &data) override;
+  /// Same frame, straight into hardware items: a bit per item, unless the clock is too fast for the pulses
+  void encode(RemoteTransmitItems *dst, const LacrosseData &data);
   optional<LacrosseData> decode(RemoteReceiveData src) override;
+  /// Decode a frame received at now_ms (replayed streams have their own clock)
+  optional<LacrosseData> decode(RemoteReceiveData src, uint32_t now_ms);
   void dump(const LacrosseData &data) override;
+
+  /// State shared by the decoders of the firmware
+  static LacrosseState &global_state();
+  /// Transmission schedule learned from the decoded frames
+  static LacrosseScheduler &scheduler() { return global_state().scheduler; }
+  /// Overlapping transmissions statistics
+  static LacrosseCollisions &collisions() { return global_state().collisions; }
+  /// Per stage latencies
+  static LacrosseLatency &latency() { return global_state().latency; }
+  /// Readings kept while the collector cannot be reached
+  static LacrosseHistory &history() { return global_state().history; }
+  /// Repeated frames short-circuit, hits and misses
+  static LacrosseFrameCache &cache() { return global_state().cache; }
+  /// Binary telemetry of the readings, disabled until a writer is set
+  static LacrosseTelemetry &telemetry();
+
  private:
+  int8_t readBit(RemoteReceiveData &src, uint32_t one_mark_us, uint32_t one_space_us, uint32_t zero_mark_us,
+                 uint32_t zero_space_us, bool bMarkOnly = false);
+  void resetQuality();
+  uint8_t iQuality() const;
   uint8_t readNibble(RemoteReceiveData &src, bool bUltimate = false);  
   uint8_t readWsNibble(RemoteReceiveData &src);  
   bool bIsTx3Protocol(RemoteReceiveData src);
   bool bIsWs7kProtocol(RemoteReceiveData src);
   optional<LacrosseData> decodeTx(RemoteReceiveData src);
+  optional<LacrosseData> dedupeTx(LacrosseData &out);
   optional<LacrosseData> decodeWs(RemoteReceiveData src);
+  void observe(uint8_t family, uint8_t address, uint8_t type);
+  void recordHistory(uint8_t family, uint8_t address, uint8_t type, char quantity, float value);
+  void recordMeasures(const LacrosseData &out);
+  void cacheStore(const LacrosseData &out);
+  optional<LacrosseData> replay(const LacrosseCacheEntry &entry);
+  bool bSeparateCollision(RemoteReceiveData src);
+  optional<LacrosseData> decodeCollision(RemoteReceiveData src);
+
+  LacrosseState *state_;
+  uint32_t now_ms_{0};
+  LacrosseTrace trace_{};
+  LacrosseArrival arrival_{ARRIVAL_FIRST};
+  uint64_t hash_{0};  // of the frame decoded, 0 when not to be cached
+  uint16_t pulses_{0};
+  uint32_t iConfidence_{0}; // sum of the bits confidences (0..255 each)
+  uint8_t iConfidenceMin_{UINT8_MAX}; // weakest bit of the frame
+  uint16_t iBits_{0};
+  bool decoded_{false};
+  bool filtered_{false};  // address not configured
+  bool cached_{false};  // replayed from the cache
+  bool first_decoder_{true};  // of the frame, among the listeners and dumpers
 };
 
 
+#ifndef USE_REMOTE_BASE_HOST
+
 DECLARE_REMOTE_PROTOCOL(Lacrosse)
 
 
 template<typename... Ts> class LacrosseAction : public RemoteTransmitterActionBase<Ts...> {
  public:
-  TEMPLATABLE_VALUE(std::string, data)
+  TEMPLATABLE_VALUE(uint8_t, address)
+  TEMPLATABLE_VALUE(uint8_t, type)
+  TEMPLATABLE_VALUE(float, value)
 
-  void encode(RemoteTransmitData *dst, Ts... x) override {
+  void encode(RemoteTransmitData *dst, Ts... x) override { LacrosseProtocol().encode(dst, this->reading_(x...)); }
+
+ protected:
+  LacrosseData reading_(Ts... x) {
     LacrosseData data{};
-    data.value = this->data_.value(x...);
-    LacrosseProtocol().encode(dst, data);
+    data.family = LACROSSE_FAMILY_TX;
+    data.address = this->address_.value(x...);
+    data.type = this->type_.value(x...);
+    data.value = this->value_.value(x...);
+    return data;
   }
 };
 
+#endif  // USE_REMOTE_BASE_HOST
+
 
 }  // namespace remote_base
 }  // namespace esphome
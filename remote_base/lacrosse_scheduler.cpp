@@ -0,0 +1,151 @@
+#include "lacrosse_scheduler.h"
+#ifdef USE_REMOTE_BASE_HOST
+#include "esphome_host.h"
+#else
+#include "esphome/core/defines.h"
+#include "esphome/core/log.h"
+#endif
+
+// part of the Lacrosse protocol, built with it
+#if defined(USE_REMOTE_BASE_LACROSSE) || defined(USE_REMOTE_BASE_HOST)
+
+namespace esphome {
+namespace remote_base {
+
+static const char *const TAG = "remote.lacrosse";
+
+LacrosseSchedule *LacrosseScheduler::find_(uint8_t family, uint8_t address, uint8_t type) {
+  for (uint8_t iSlot = 0; iSlot < this->count_; iSlot++) {
+    LacrosseSchedule &slot = this->slots_[iSlot];
+    if (slot.family == family && slot.address == address && slot.type == type)
+      return &slot;
+  }
+  return nullptr;
+}
+
+bool LacrosseScheduler::in_window_(const LacrosseSchedule &slot, uint32_t now_ms) {
+  if (slot.period_ms == 0)
+    return false;
+  const uint32_t delta = now_ms - slot.last_ms;
+  const uint32_t k = (delta + slot.period_ms / 2) / slot.period_ms;
+  if (k == 0)
+    return false;
+  const uint32_t center = k * slot.period_ms;
+  const uint32_t error = delta > center ? delta - center : center - delta;
+  return error <= jitter_(slot);
+}
+
+void LacrosseScheduler::check_missed(uint32_t now_ms) {
+  for (uint8_t iSlot = 0; iSlot < this->count_; iSlot++) {
+    LacrosseSchedule &slot = this->slots_[iSlot];
+    if (slot.period_ms == 0)
+      continue;
+    const uint32_t delta = now_ms - slot.last_ms;
+    const uint32_t jitter = jitter_(slot);
+    if (delta <= jitter)
+      continue;
+    const uint32_t closed = (delta - jitter - 1) / slot.period_ms;  // windows ended before now_ms
+    if (closed > slot.missed) {
+      ESP_LOGD(TAG, "%s%02X%01X missed %u window(s)", slot.family == LACROSSE_FAMILY_TX ? "TX" : "WS", slot.address,
+               slot.type, closed - slot.missed);
+      this->missed_ += closed - slot.missed;
+      slot.missed = closed;
+    }
+  }
+}
+
+LacrosseArrival LacrosseScheduler::observe(uint8_t family, uint8_t address, uint8_t type, uint32_t now_ms) {
+  this->check_missed(now_ms);
+
+  LacrosseSchedule *slot = this->find_(family, address, type);
+  if (slot == nullptr) {
+    if (this->count_ < SCHEDULE_SLOTS_MAX) {
+      this->slots_[this->count_++] = LacrosseSchedule{
+          .family = family,
+          .address = address,
+          .type = type,
+          .misfits = 0,
+          .last_ms = now_ms,
+          .period_ms = 0,
+          .missed = 0,
+      };
+    }
+    return ARRIVAL_FIRST;
+  }
+
+  const uint32_t delta = now_ms - slot->last_ms;
+  if (delta < SCHEDULE_REPEAT_MS)
+    return ARRIVAL_REPEAT;
+
+  if (slot->period_ms == 0) {
+    if (delta >= SCHEDULE_PERIOD_MIN_MS && delta <= SCHEDULE_PERIOD_MAX_MS)
+      slot->period_ms = delta;
+    slot->last_ms = now_ms;
+    slot->missed = 0;
+    return ARRIVAL_LEARNING;
+  }
+
+  if (in_window_(*slot, now_ms)) {
+    // refine the period, a late arrival after missed windows counts for several periods
+    const uint32_t k = (delta + slot->period_ms / 2) / slot->period_ms;
+    const int32_t error = int32_t(delta / k) - int32_t(slot->period_ms);
+    slot->period_ms += error / 8;
+    slot->last_ms = now_ms;
+    slot->missed = 0;
+    slot->misfits = 0;
+    return ARRIVAL_EXPECTED;
+  }
+
+  this->unexpected_++;
+  if (++slot->misfits >= SCHEDULE_RELEARN) {
+    ESP_LOGD(TAG, "%s%02X%01X lost its schedule, learning again", family == LACROSSE_FAMILY_TX ? "TX" : "WS",
+             address, type);
+    slot->period_ms = 0;
+    slot->last_ms = now_ms;
+    slot->missed = 0;
+    slot->misfits = 0;
+  }
+  return ARRIVAL_UNEXPECTED;
+}
+
+void LacrosseScheduler::frame_failed(uint32_t now_ms) {
+  this->check_missed(now_ms);  // a jammed band only brings failed frames
+  if (this->is_expected(now_ms))
+    this->failed_in_window_++;
+}
+
+bool LacrosseScheduler::is_expected(uint32_t now_ms, uint8_t *family) const {
+  for (uint8_t iSlot = 0; iSlot < this->count_; iSlot++) {
+    const LacrosseSchedule &slot = this->slots_[iSlot];
+    if (in_window_(slot, now_ms)) {
+      if (family != nullptr)
+        *family = slot.family;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LacrosseScheduler::next_window(uint8_t family, uint8_t address, uint8_t type, uint32_t now_ms,
+                                    uint32_t *from_ms, uint32_t *to_ms) const {
+  for (uint8_t iSlot = 0; iSlot < this->count_; iSlot++) {
+    const LacrosseSchedule &slot = this->slots_[iSlot];
+    if (slot.family != family || slot.address != address || slot.type != type)
+      continue;
+    if (slot.period_ms == 0)
+      return false;
+    const uint32_t jitter = jitter_(slot);
+    uint32_t k = (now_ms - slot.last_ms) / slot.period_ms;
+    if (k == 0 || now_ms - slot.last_ms > k * slot.period_ms + jitter)
+      k++;
+    *from_ms = slot.last_ms + k * slot.period_ms - jitter;
+    *to_ms = slot.last_ms + k * slot.period_ms + jitter;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace remote_base
+}  // namespace esphome
+
+#endif  // USE_REMOTE_BASE_LACROSSE
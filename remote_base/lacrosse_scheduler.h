@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+namespace esphome {
+namespace remote_base {
+
+// Lacrosse sensors transmit at nearly fixed intervals (TX3 every ~55-65 s, WS7000 every ~155-185 s).
+// The scheduler learns the period and the phase of each sensor from the decode timestamps, predicts
+// the next arrival windows and flags the frames arriving outside of them as well as the windows
+// closing without any arrival (usually a collision with another transmitter).
+
+static const uint8_t LACROSSE_FAMILY_TX = 0;
+static const uint8_t LACROSSE_FAMILY_WS = 1;
+static const uint8_t LACROSSE_FAMILY_NONE = 0xFF;
+
+static const uint8_t SCHEDULE_SLOTS_MAX = 30;
+
+static const uint32_t SCHEDULE_REPEAT_MS = 1000;        // TX3 repeats its packet within a few ms
+static const uint32_t SCHEDULE_PERIOD_MIN_MS = 10000;
+static const uint32_t SCHEDULE_PERIOD_MAX_MS = 600000;
+static const uint32_t SCHEDULE_JITTER_MS = 2000;        // minimal half width of a window
+static const uint8_t SCHEDULE_RELEARN = 3;              // consecutive misfits before forgetting the period
+
+enum LacrosseArrival : uint8_t {
+  ARRIVAL_FIRST = 0,   // first time this sensor is seen
+  ARRIVAL_REPEAT,      // repeated packet of the same transmission
+  ARRIVAL_LEARNING,    // period not learned yet
+  ARRIVAL_EXPECTED,    // inside the predicted window
+  ARRIVAL_UNEXPECTED,  // outside the predicted window
+};
+
+struct LacrosseSchedule {
+  uint8_t family;
+  uint8_t address;
+  uint8_t type;
+  uint8_t misfits;     // consecutive arrivals outside the window
+  uint32_t last_ms;    // phase: timestamp of the last arrival in a window
+  uint32_t period_ms;  // 0 while not learned
+  uint32_t missed;     // windows already reported as missed since last_ms
+};
+
+class LacrosseScheduler {
+ public:
+  /// Record a successfully decoded frame and learn from it.
+  LacrosseArrival observe(uint8_t family, uint8_t address, uint8_t type, uint32_t now_ms);
+  /// Record a frame that could not be decoded, and close the windows ended before it.
+  void frame_failed(uint32_t now_ms);
+
+  /// Close the windows that ended before now_ms and count them as missed.
+  void check_missed(uint32_t now_ms);
+
+  /// Is any learned sensor expected at now_ms ? Optionally returns its family.
+  bool is_expected(uint32_t now_ms, uint8_t *family = nullptr) const;
+  /// Family to try first for a frame received at now_ms, LACROSSE_FAMILY_NONE if nobody is expected.
+  uint8_t preferred_family(uint32_t now_ms) const {
+    uint8_t family = LACROSSE_FAMILY_NONE;
+    this->is_expected(now_ms, &family);
+    return family;
+  }
+  /// Next arrival window of a sensor at or after now_ms. False if the sensor period is not learned yet.
+  bool next_window(uint8_t family, uint8_t address, uint8_t type, uint32_t now_ms, uint32_t *from_ms,
+                   uint32_t *to_ms) const;
+
+  uint8_t size() const { return this->count_; }
+  const LacrosseSchedule &at(uint8_t index) const { return this->slots_[index]; }
+
+  uint32_t get_unexpected() const { return this->unexpected_; }
+  uint32_t get_missed() const { return this->missed_; }
+  uint32_t get_failed_in_window() const { return this->failed_in_window_; }
+
+ protected:
+  static uint32_t jitter_(const LacrosseSchedule &slot) {
+    return slot.period_ms / 16 > SCHEDULE_JITTER_MS ? slot.period_ms / 16 : SCHEDULE_JITTER_MS;
+  }
+  static bool in_window_(const LacrosseSchedule &slot, uint32_t now_ms);
+  LacrosseSchedule *find_(uint8_t family, uint8_t address, uint8_t type);
+
+  LacrosseSchedule slots_[SCHEDULE_SLOTS_MAX]{};
+  uint8_t count_{0};
+  uint32_t unexpected_{0};
+  uint32_t missed_{0};
+  uint32_t failed_in_window_{0};
+};
+
+}  // namespace remote_base
+}  // namespace esphome
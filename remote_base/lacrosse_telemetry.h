@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace remote_base {
+
+// Binary telemetry of the decoded readings, for the gateways forwarding them to a collector.
+//
+// Fixed size records of 16 bytes, little endian:
+//
+//   0      sync (0xA5)
+//   1      family (0: TX, 1: WS)
+//   2      address
+//   3      sensor type
+//   4      physical quantity, as in the buffer ('0' temperature, 'E' humidity, 'P' pression...)
+//   5      quality, per cent - 0 when not measured (frame replayed from the cache, history drained)
+//   6..9   value x 100, signed, saturated (WS7000 brightness goes up to 999 x 10^15)
+//   10..13 timestamp, ms
+//   14..15 CRC-16/CCITT of bytes 0..13
+//
+// Shared by the firmware and the host readers: no esphome dependency.
+
+static const uint8_t LACROSSE_RECORD_SYNC = 0xA5;
+static const size_t LACROSSE_RECORD_SIZE = 16;
+
+struct LacrosseRecord
+{
+    uint8_t family;
+    uint8_t address;
+    uint8_t type;
+    char quantity;
+    uint8_t quality;
+    int32_t value_centi;
+    uint32_t timestamp_ms;
+};
+
+/// Fixed point value (value x scale), saturated to the int32 range, 0 for NaN
+inline int32_t lacrosse_fixed_point(float value, int32_t scale) {
+  const float scaled = value * scale;
+  if (std::isnan(scaled))
+    return 0;
+  if (scaled >= 2147483520.0f)  // largest float below 2^31
+    return INT32_MAX;
+  if (scaled <= -2147483648.0f)
+    return INT32_MIN;
+  return int32_t(lroundf(scaled));
+}
+
+inline uint16_t lacrosse_record_crc(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= uint16_t(data[i]) << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+inline void lacrosse_record_encode(const LacrosseRecord &record, uint8_t *out) {
+  const uint32_t value = uint32_t(record.value_centi);
+  out[0] = LACROSSE_RECORD_SYNC;
+  out[1] = record.family;
+  out[2] = record.address;
+  out[3] = record.type;
+  out[4] = uint8_t(record.quantity);
+  out[5] = record.quality;
+  for (uint8_t i = 0; i < 4; i++) {
+    out[6 + i] = value >> (8 * i);
+    out[10 + i] = record.timestamp_ms >> (8 * i);
+  }
+  const uint16_t crc = lacrosse_record_crc(out, LACROSSE_RECORD_SIZE - 2);
+  out[14] = crc;
+  out[15] = crc >> 8;
+}
+
+/// Checks the sync and the CRC of the record starting at data
+inline bool lacrosse_record_valid(const uint8_t *data) {
+  return data[0] == LACROSSE_RECORD_SYNC &&
+         lacrosse_record_crc(data, LACROSSE_RECORD_SIZE - 2) == (data[14] | uint16_t(data[15]) << 8);
+}
+
+}  // namespace remote_base
+}  // namespace esphome
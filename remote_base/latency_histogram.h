@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+namespace esphome {
+namespace remote_base {
+
+/// Latencies in microseconds counted in fixed power of two buckets: bucket i holds [2^(i-1), 2^i[.
+/// Recording is a count leading zeros and an increment, no allocation.
+class LatencyHistogram {
+ public:
+  static const uint8_t BUCKETS = 33;
+
+  void record(uint32_t latency_us) {
+    this->counts_[bucket_(latency_us)]++;
+    this->count_++;
+    this->sum_us_ += latency_us;
+    if (latency_us > this->max_us_)
+      this->max_us_ = latency_us;
+  }
+
+  /// Upper bound of the bucket holding the given percentile (0..100) of the samples, at most the maximum
+  uint32_t percentile(uint8_t percent) const {
+    if (this->count_ == 0)
+      return 0;
+    const uint32_t rank = (uint64_t(this->count_) * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t bucket = 0; bucket < BUCKETS; bucket++) {
+      seen += this->counts_[bucket];
+      if (seen >= rank && seen > 0)
+        return bucket == 0 ? 0 : bucket >= 32 ? this->max_us_ : std::min((uint32_t(1) << bucket) - 1, this->max_us_);
+    }
+    return this->max_us_;
+  }
+
+  uint32_t get_count() const { return this->count_; }
+  uint32_t get_bucket(uint8_t bucket) const { return this->counts_[bucket]; }
+  uint32_t get_max() const { return this->max_us_; }
+  uint32_t get_mean() const { return this->count_ == 0 ? 0 : this->sum_us_ / this->count_; }
+
+  void reset() { *this = LatencyHistogram(); }
+  /// Adds the samples of another histogram (the streams of a host replay)
+  void merge(const LatencyHistogram &other) {
+    for (uint8_t bucket = 0; bucket < BUCKETS; bucket++)
+      this->counts_[bucket] += other.counts_[bucket];
+    this->count_ += other.count_;
+    this->sum_us_ += other.sum_us_;
+    if (other.max_us_ > this->max_us_)
+      this->max_us_ = other.max_us_;
+  }
+
+ protected:
+  static uint8_t bucket_(uint32_t latency_us) { return latency_us == 0 ? 0 : 32 - __builtin_clz(latency_us); }
+
+  uint32_t counts_[BUCKETS]{};
+  uint32_t count_{0};
+  uint32_t max_us_{0};
+  uint64_t sum_us_{0};
+};
+
+}  // namespace remote_base
+}  // namespace esphome
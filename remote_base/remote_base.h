@@ -6,6 +6,7 @@
 #include "esphome/core/hal.h"
 #include "esphome/core/automation.h"
 #include "esphome/components/binary_sensor/binary_sensor.h"
+#include "remote_data.h"
 
 #ifdef USE_ESP32
 #include <driver/rmt.h>
@@ -14,146 +15,6 @@
 namespace esphome {
 namespace remote_base {
 
-class RemoteTransmitData {
- public:
-  void mark(uint32_t length) { this->data_.push_back(length); }
-
-  void space(uint32_t length) { this->data_.push_back(-length); }
-
-  void item(uint32_t mark, uint32_t space) {
-    this->mark(mark);
-    this->space(space);
-  }
-
-  void reserve(uint32_t len) { this->data_.reserve(len); }
-
-  void set_carrier_frequency(uint32_t carrier_frequency) { this->carrier_frequency_ = carrier_frequency; }
-
-  uint32_t get_carrier_frequency() const { return this->carrier_frequency_; }
-
-  const std::vector<int32_t> &get_data() const { return this->data_; }
-
-  void set_data(const std::vector<int32_t> &data) {
-    this->data_.clear();
-    this->data_.reserve(data.size());
-    for (auto dat : data)
-      this->data_.push_back(dat);
-  }
-
-  void reset() {
-    this->data_.clear();
-    this->carrier_frequency_ = 0;
-  }
-
-  std::vector<int32_t>::iterator begin() { return this->data_.begin(); }
-
-  std::vector<int32_t>::iterator end() { return this->data_.end(); }
-
- protected:
-  std::vector<int32_t> data_{};
-  uint32_t carrier_frequency_{0};
-};
-
-class RemoteReceiveData {
- public:
-  RemoteReceiveData(std::vector<int32_t> *data, uint8_t tolerance) : data_(data), tolerance_(tolerance) {}
-
-  bool peek_mark(uint32_t length, uint32_t offset = 0) {
-    if (int32_t(this->index_ + offset) >= this->size())
-      return false;
-    int32_t value = this->peek(offset);
-    const int32_t lo = this->lower_bound_(length);
-    const int32_t hi = this->upper_bound_(length);
-    return value >= 0 && lo <= value && value <= hi;
-  }
-
-  bool peek_space(uint32_t length, uint32_t offset = 0) {
-    if (int32_t(this->index_ + offset) >= this->size())
-      return false;
-    int32_t value = this->peek(offset);
-    const int32_t lo = this->lower_bound_(length);
-    const int32_t hi = this->upper_bound_(length);
-    return value <= 0 && lo <= -value && -value <= hi;
-  }
-
-  bool peek_space_at_least(uint32_t length, uint32_t offset = 0) {
-    if (int32_t(this->index_ + offset) >= this->size())
-      return false;
-    int32_t value = this->pos(this->index_ + offset);
-    const int32_t lo = this->lower_bound_(length);
-    return value <= 0 && lo <= -value;
-  }
-
-  bool peek_item(uint32_t mark, uint32_t space, uint32_t offset = 0) {
-    return this->peek_mark(mark, offset) && this->peek_space(space, offset + 1);
-  }
-
-  int32_t peek(uint32_t offset = 0) { return (*this)[this->index_ + offset]; }
-
-  void advance(uint32_t amount = 1) { this->index_ += amount; }
-
-  bool expect_mark(uint32_t length) {
-    if (this->peek_mark(length)) {
-      this->advance();
-      return true;
-    }
-    return false;
-  }
-
-  bool expect_space(uint32_t length) {
-    if (this->peek_space(length)) {
-      this->advance();
-      return true;
-    }
-    return false;
-  }
-
-  bool expect_item(uint32_t mark, uint32_t space) {
-    if (this->peek_item(mark, space)) {
-      this->advance(2);
-      return true;
-    }
-    return false;
-  }
-
-  bool expect_pulse_with_gap(uint32_t mark, uint32_t space) {
-    if (this->peek_mark(mark, 0) && this->peek_space_at_least(space, 1)) {
-      this->advance(2);
-      return true;
-    }
-    return false;
-  }
-
-  uint32_t get_index() { return index_; }
-
-  void reset() { this->index_ = 0; }
-
-  int32_t pos(uint32_t index) const { return (*this->data_)[index]; }
-
-  int32_t operator[](uint32_t index) const { return this->pos(index); }
-
-  int32_t size() const { return this->data_->size(); }
-
-  std::vector<int32_t> *get_raw_data() { return this->data_; }
-
- protected:
-  int32_t lower_bound_(uint32_t length) { return int32_t(100 - this->tolerance_) * length / 100U; }
-  int32_t upper_bound_(uint32_t length) { return int32_t(100 + this->tolerance_) * length / 100U; }
-
-  uint32_t index_{0};
-  std::vector<int32_t> *data_;
-  uint8_t tolerance_;
-};
-
-template<typename T> class RemoteProtocol {
- public:
-  virtual void encode(RemoteTransmitData *dst, const T &data) = 0;
-
-  virtual optional<T> decode(RemoteReceiveData src) = 0;
-
-  virtual void dump(const T &data) = 0;
-};
-
 class RemoteComponentBase {
  public:
   explicit RemoteComponentBase(InternalGPIOPin *pin) : pin_(pin){};
@@ -171,14 +32,9 @@ class RemoteRMTChannel {
   void set_clock_divider(uint8_t clock_divider) { this->clock_divider_ = clock_divider; }
 
  protected:
-  uint32_t from_microseconds_(uint32_t us) {
-    const uint32_t ticks_per_ten_us = 80000000u / this->clock_divider_ / 100000u;
-    return us * ticks_per_ten_us / 10;
-  }
-  uint32_t to_microseconds_(uint32_t ticks) {
-    const uint32_t ticks_per_ten_us = 80000000u / this->clock_divider_ / 100000u;
-    return (ticks * 10) / ticks_per_ten_us;
-  }
+  uint32_t ticks_per_ten_us_() const { return 80000000u / this->clock_divider_ / 100000u; }
+  uint32_t from_microseconds_(uint32_t us) { return remote_ticks_from_us(us, this->ticks_per_ten_us_()); }
+  uint32_t to_microseconds_(uint32_t ticks) { return remote_us_from_ticks(ticks, this->ticks_per_ten_us_()); }
   RemoteComponentBase *remote_base_;
   rmt_channel_t channel_{RMT_CHANNEL_0};
   uint8_t mem_block_num_;
@@ -243,10 +99,15 @@ class RemoteReceiverBase : public RemoteComponentBase {
   void set_tolerance(uint8_t tolerance) { tolerance_ = tolerance; }
 
  protected:
+  /// To be called by the receivers before the listeners and dumpers, for the latency tracing
+  void set_frame_timestamps_(uint32_t first_edge_us, uint32_t frame_close_us) {
+    this->timestamps_.first_edge_us = first_edge_us;
+    this->timestamps_.frame_close_us = frame_close_us;
+  }
   bool call_listeners_() {
     bool success = false;
     for (auto *listener : this->listeners_) {
-      auto data = RemoteReceiveData(&this->temp_, this->tolerance_);
+      auto data = RemoteReceiveData(&this->temp_, this->tolerance_, &this->timestamps_);
       if (listener->on_receive(data))
         success = true;
     }
@@ -255,28 +116,40 @@ class RemoteReceiverBase : public RemoteComponentBase {
   void call_dumpers_() {
     bool success = false;
     for (auto *dumper : this->dumpers_) {
-      auto data = RemoteReceiveData(&this->temp_, this->tolerance_);
+      auto data = RemoteReceiveData(&this->temp_, this->tolerance_, &this->timestamps_);
       if (dumper->dump(data))
         success = true;
     }
     if (!success) {
       for (auto *dumper : this->secondary_dumpers_) {
-        auto data = RemoteReceiveData(&this->temp_, this->tolerance_);
+        auto data = RemoteReceiveData(&this->temp_, this->tolerance_, &this->timestamps_);
         dumper->dump(data);
       }
     }
   }
   void call_listeners_dumpers_() {
-    if (this->call_listeners_())
-      return;
+    if (this->timestamps_.frame_close_us == 0)
+      this->stamp_frame_();
     // If a listener handled, then do not dump
-    this->call_dumpers_();
+    if (!this->call_listeners_())
+      this->call_dumpers_();
+    this->timestamps_ = RemoteReceiveTimestamps{};
+  }
+  /// Receivers not calling set_frame_timestamps_(): the frame closes now, its first edge is estimated
+  /// from its durations
+  void stamp_frame_() {
+    uint32_t duration_us = 0;
+    for (int32_t pulse : this->temp_)
+      duration_us += pulse < 0 ? -pulse : pulse;
+    this->timestamps_.frame_close_us = micros();
+    this->timestamps_.first_edge_us = this->timestamps_.frame_close_us - duration_us;
   }
 
   std::vector<RemoteReceiverListener *> listeners_;
   std::vector<RemoteReceiverDumperBase *> dumpers_;
   std::vector<RemoteReceiverDumperBase *> secondary_dumpers_;
   std::vector<int32_t> temp_;
+  RemoteReceiveTimestamps timestamps_{};
   uint8_t tolerance_{25};
 };
 
@@ -362,6 +235,40 @@ template<typename T, typename D> class RemoteReceiverDumper : public RemoteRecei
   }
 };
 
+/// Dumpers of a receiver, known at build time: the dumpers are members and their calls are resolved
+/// by the compiler, in the order of the configuration.
+template<typename... Ds> class RemoteReceiverDumperList {
+ public:
+  bool dump(const RemoteReceiveData &src, bool secondary) { return false; }
+};
+
+template<typename D, typename... Ds> class RemoteReceiverDumperList<D, Ds...> {
+ public:
+  bool dump(const RemoteReceiveData &src, bool secondary) {
+    const bool success = this->dumper_.is_secondary() == secondary && this->dumper_.dump(src);
+    return this->next_.dump(src, secondary) || success;
+  }
+
+ protected:
+  D dumper_;
+  RemoteReceiverDumperList<Ds...> next_;
+};
+
+/// The only dumper registered by the generated code: a single virtual call per frame, the secondary
+/// dumpers running when no primary one decoded the frame, as in RemoteReceiverBase::call_dumpers_().
+template<typename... Ds> class RemoteReceiverStaticDumper : public RemoteReceiverDumperBase {
+ public:
+  bool dump(RemoteReceiveData src) override {
+    if (this->dumpers_.dump(src, false))
+      return true;
+    this->dumpers_.dump(src, true);
+    return false;
+  }
+
+ protected:
+  RemoteReceiverDumperList<Ds...> dumpers_;
+};
+
 #define DECLARE_REMOTE_PROTOCOL_(prefix) \
   using prefix##BinarySensor = RemoteReceiverBinarySensor<prefix##Protocol, prefix##Data>; \
   using prefix##Trigger = RemoteReceiverTrigger<prefix##Protocol, prefix##Data>; \
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#ifdef USE_REMOTE_BASE_HOST
+#include "esphome_host.h"
+#else
+#include "esphome/core/optional.h"
+#endif
+
+// Pulses data and protocol interface, without the component dependencies: the decoders using
+// only these also build on a Linux host (USE_REMOTE_BASE_HOST, see host/esphome_host.h).
+
+namespace esphome {
+namespace remote_base {
+
+class RemoteTransmitData {
+ public:
+  void mark(uint32_t length) { this->data_.push_back(length); }
+
+  void space(uint32_t length) { this->data_.push_back(-length); }
+
+  void item(uint32_t mark, uint32_t space) {
+    this->mark(mark);
+    this->space(space);
+  }
+
+  void reserve(uint32_t len) { this->data_.reserve(len); }
+
+  void set_carrier_frequency(uint32_t carrier_frequency) { this->carrier_frequency_ = carrier_frequency; }
+
+  uint32_t get_carrier_frequency() const { return this->carrier_frequency_; }
+
+  const std::vector<int32_t> &get_data() const { return this->data_; }
+
+  void set_data(const std::vector<int32_t> &data) {
+    this->data_.clear();
+    this->data_.reserve(data.size());
+    for (auto dat : data)
+      this->data_.push_back(dat);
+  }
+
+  void reset() {
+    this->data_.clear();
+    this->carrier_frequency_ = 0;
+  }
+
+  std::vector<int32_t>::iterator begin() { return this->data_.begin(); }
+
+  std::vector<int32_t>::iterator end() { return this->data_.end(); }
+
+ protected:
+  std::vector<int32_t> data_{};
+  uint32_t carrier_frequency_{0};
+};
+
+/// Hardware clock ticks of a duration, the clock given in ticks per 10 us (RMT: 80 MHz / divider / 100 kHz)
+inline uint32_t remote_ticks_from_us(uint32_t us, uint32_t ticks_per_ten_us) { return us * ticks_per_ten_us / 10; }
+inline uint32_t remote_us_from_ticks(uint32_t ticks, uint32_t ticks_per_ten_us) {
+  return ticks * 10 / ticks_per_ten_us;
+}
+
+/// Same layout as the ESP32 rmt_item32_t: two levels with their durations, in ticks
+struct RemoteTransmitItem {
+  uint32_t duration0 : 15;
+  uint32_t level0 : 1;
+  uint32_t duration1 : 15;
+  uint32_t level1 : 1;
+};
+static_assert(sizeof(RemoteTransmitItem) == sizeof(uint32_t), "RemoteTransmitItem must pack in 32 bits");
+
+/// Transmit buffer in the hardware items format, filled directly by the encoders: no durations
+/// vector to convert before each transmission. The storage is kept from one transmission to the next.
+class RemoteTransmitItems {
+ public:
+  static constexpr uint32_t DURATION_MAX = 0x7FFF;  // ticks, longer pulses are split
+
+  void reset(uint32_t ticks_per_ten_us) {
+    this->items_.clear();
+    this->half_ = false;
+    this->ticks_per_ten_us_ = ticks_per_ten_us;
+  }
+  void reserve(uint32_t len) { this->items_.reserve(len); }
+
+  uint32_t to_ticks(uint32_t us) const { return remote_ticks_from_us(us, this->ticks_per_ten_us_); }
+
+  /// Item of a mark and a space, for the encoders converting their timings once (up to DURATION_MAX)
+  RemoteTransmitItem make_item(uint32_t mark_us, uint32_t space_us) const {
+    return RemoteTransmitItem{std::min(this->to_ticks(mark_us), DURATION_MAX), 1,
+                              std::min(this->to_ticks(space_us), DURATION_MAX), 0};
+  }
+  void push(RemoteTransmitItem item) {
+    if (this->half_) {  // not aligned on an item
+      this->append_half_(item.level0, item.duration0);
+      this->append_half_(item.level1, item.duration1);
+    } else {
+      this->items_.push_back(item);
+    }
+  }
+
+  void mark(uint32_t us) { this->pulse_(1, this->to_ticks(us)); }
+  void space(uint32_t us) { this->pulse_(0, this->to_ticks(us)); }
+  void item(uint32_t mark_us, uint32_t space_us) {
+    this->mark(mark_us);
+    this->space(space_us);
+  }
+
+  /// Back to durations in us, for the transmitters without items support
+  void to_data(RemoteTransmitData *dst) const {
+    dst->reserve(this->items_.size() * 2);
+    uint32_t pending = 0;  // ticks of the pulse being merged, split pulses are converted as a whole
+    bool pending_level = false;
+    for (const RemoteTransmitItem &item : this->items_) {
+      for (uint8_t i = 0; i < 2; i++) {
+        const uint32_t ticks = i == 0 ? item.duration0 : item.duration1;
+        const bool level = i == 0 ? item.level0 : item.level1;
+        if (ticks == 0)
+          continue;
+        if (pending != 0 && pending_level != level)
+          this->flush_(dst, pending_level, pending);
+        pending = pending_level == level ? pending + ticks : ticks;
+        pending_level = level;
+      }
+    }
+    if (pending != 0)
+      this->flush_(dst, pending_level, pending);
+  }
+
+  const RemoteTransmitItem *data() const { return this->items_.data(); }
+  size_t size() const { return this->items_.size(); }
+  uint32_t get_ticks_per_ten_us() const { return this->ticks_per_ten_us_; }
+
+ protected:
+  void flush_(RemoteTransmitData *dst, bool level, uint32_t &ticks) const {
+    const uint32_t us = remote_us_from_ticks(ticks, this->ticks_per_ten_us_);
+    level ? dst->mark(us) : dst->space(us);
+    ticks = 0;
+  }
+  void pulse_(bool level, uint32_t ticks) {
+    for (; ticks > DURATION_MAX; ticks -= DURATION_MAX)
+      this->append_half_(level, DURATION_MAX);
+    this->append_half_(level, ticks);
+  }
+  void append_half_(bool level, uint32_t ticks) {
+    if (this->half_) {
+      this->items_.back().duration1 = ticks;
+      this->items_.back().level1 = level;
+    } else {
+      this->items_.push_back(RemoteTransmitItem{ticks, level, 0, 0});
+    }
+    this->half_ = !this->half_;
+  }
+
+  std::vector<RemoteTransmitItem> items_{};
+  bool half_{false};  // last item with its second half free
+  uint32_t ticks_per_ten_us_{10};
+};
+
+/// Monotonic timestamps (micros) of the frame in the receiver, 0 when not known
+struct RemoteReceiveTimestamps {
+  uint32_t first_edge_us;
+  uint32_t frame_close_us;
+};
+
+class RemoteReceiveData {
+ public:
+  RemoteReceiveData(std::vector<int32_t> *data, uint8_t tolerance,
+                    const RemoteReceiveTimestamps *timestamps = nullptr)
+      : data_(data), tolerance_(tolerance), timestamps_(timestamps) {}
+
+  bool peek_mark(uint32_t length, uint32_t offset = 0) {
+    if (int32_t(this->index_ + offset) >= this->size())
+      return false;
+    int32_t value = this->peek(offset);
+    const int32_t lo = this->lower_bound_(length);
+    const int32_t hi = this->upper_bound_(length);
+    return value >= 0 && lo <= value && value <= hi;
+  }
+
+  bool peek_space(uint32_t length, uint32_t offset = 0) {
+    if (int32_t(this->index_ + offset) >= this->size())
+      return false;
+    int32_t value = this->peek(offset);
+    const int32_t lo = this->lower_bound_(length);
+    const int32_t hi = this->upper_bound_(length);
+    return value <= 0 && lo <= -value && -value <= hi;
+  }
+
+  bool peek_space_at_least(uint32_t length, uint32_t offset = 0) {
+    if (int32_t(this->index_ + offset) >= this->size())
+      return false;
+    int32_t value = this->pos(this->index_ + offset);
+    const int32_t lo = this->lower_bound_(length);
+    return value <= 0 && lo <= -value;
+  }
+
+  bool peek_item(uint32_t mark, uint32_t space, uint32_t offset = 0) {
+    return this->peek_mark(mark, offset) && this->peek_space(space, offset + 1);
+  }
+
+  int32_t peek(uint32_t offset = 0) { return (*this)[this->index_ + offset]; }
+
+  void advance(uint32_t amount = 1) { this->index_ += amount; }
+
+  bool expect_mark(uint32_t length) {
+    if (this->peek_mark(length)) {
+      this->advance();
+      return true;
+    }
+    return false;
+  }
+
+  bool expect_space(uint32_t length) {
+    if (this->peek_space(length)) {
+      this->advance();
+      return true;
+    }
+    return false;
+  }
+
+  bool expect_item(uint32_t mark, uint32_t space) {
+    if (this->peek_item(mark, space)) {
+      this->advance(2);
+      return true;
+    }
+    return false;
+  }
+
+  bool expect_pulse_with_gap(uint32_t mark, uint32_t space) {
+    if (this->peek_mark(mark, 0) && this->peek_space_at_least(space, 1)) {
+      this->advance(2);
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t get_index() { return index_; }
+
+  void reset() { this->index_ = 0; }
+
+  int32_t pos(uint32_t index) const { return (*this->data_)[index]; }
+
+  int32_t operator[](uint32_t index) const { return this->pos(index); }
+
+  int32_t size() const { return this->data_->size(); }
+
+  std::vector<int32_t> *get_raw_data() { return this->data_; }
+
+  uint8_t get_tolerance() const { return this->tolerance_; }
+
+  const RemoteReceiveTimestamps *get_timestamps() const { return this->timestamps_; }
+
+ protected:
+  int32_t lower_bound_(uint32_t length) { return int32_t(100 - this->tolerance_) * length / 100U; }
+  int32_t upper_bound_(uint32_t length) { return int32_t(100 + this->tolerance_) * length / 100U; }
+
+  uint32_t index_{0};
+  std::vector<int32_t> *data_;
+  uint8_t tolerance_;
+  const RemoteReceiveTimestamps *timestamps_;
+};
+
+template<typename T> class RemoteProtocol {
+ public:
+  virtual void encode(RemoteTransmitData *dst, const T &data) = 0;
+
+  virtual optional<T> decode(RemoteReceiveData src) = 0;
+
+  virtual void dump(const T &data) = 0;
+};
+
+}  // namespace remote_base
+}  // namespace esphome
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef USE_REMOTE_BASE_HOST
+#include "esphome_host.h"
+#else
+#include "esphome/core/hal.h"
+#endif
+
+namespace esphome {
+namespace remote_base {
+
+/// Edge timestamps captured by the pin interrupt of the receivers without RMT.
+///
+/// Lock-free single writer (the ISR) / single reader (the loop): the ISR only stores the timestamp and
+/// moves the write index, the level after the edge is kept in bit 0 of the timestamp. When the reader
+/// falls behind, the new edges are dropped and counted instead of overwriting the unread ones.
+template<size_t N> class RemoteEdgeBuffer {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "RemoteEdgeBuffer size must be a power of two");
+
+ public:
+  void IRAM_ATTR push(uint32_t time_us, bool level) {
+    const uint32_t write = this->write_.load(std::memory_order_relaxed);
+    if (write - this->read_.load(std::memory_order_acquire) >= N) {
+      this->overflows_.store(this->overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+    this->edges_[write & (N - 1)] = (time_us & ~1u) | uint32_t(level);
+    this->write_.store(write + 1, std::memory_order_release);
+  }
+
+  bool pop(uint32_t *time_us, bool *level) {
+    const uint32_t read = this->read_.load(std::memory_order_relaxed);
+    if (read == this->write_.load(std::memory_order_acquire))
+      return false;
+    const uint32_t edge = this->edges_[read & (N - 1)];
+    this->read_.store(read + 1, std::memory_order_release);
+    *time_us = edge & ~1u;
+    *level = edge & 1u;
+    return true;
+  }
+
+  size_t available() const {
+    return this->write_.load(std::memory_order_acquire) - this->read_.load(std::memory_order_relaxed);
+  }
+
+  uint32_t get_overflows() const { return this->overflows_.load(std::memory_order_relaxed); }
+
+ protected:
+  uint32_t edges_[N];
+  std::atomic<uint32_t> write_{0};
+  std::atomic<uint32_t> read_{0};
+  std::atomic<uint32_t> overflows_{0};
+};
+
+/// Turns the edges of a RemoteEdgeBuffer into the mark (+) / space (-) durations of RemoteReceiveData,
+/// one frame at a time: a frame starts on a rising edge after an idle gap and ends on the next idle gap.
+/// A pulse shorter than filter_us is a glitch: both its edges are dropped and the level before it goes on.
+class RemoteEdgeFramer {
+ public:
+  RemoteEdgeFramer(uint32_t filter_us, uint32_t idle_us) : filter_us_(filter_us), idle_us_(idle_us) {}
+
+  void set_filter_us(uint32_t filter_us) { this->filter_us_ = filter_us; }
+  void set_idle_us(uint32_t idle_us) { this->idle_us_ = idle_us; }
+
+  /// Timestamps of the first edge and of the end of the last frame read
+  uint32_t get_first_edge_us() const { return this->first_us_; }
+  uint32_t get_close_us() const { return this->close_us_; }
+
+  /// Append the available edges to data, true when data holds a complete frame.
+  /// The edges after the end of the frame stay in the buffer for the next call.
+  template<size_t N> bool read(RemoteEdgeBuffer<N> &buffer, std::vector<int32_t> &data, uint32_t now_us) {
+    uint32_t time_us;
+    bool level;
+    while (buffer.pop(&time_us, &level)) {
+      if (this->edge_(time_us, level, data))
+        return true;
+    }
+    // signed: now_us is taken before the reading, the ISR may have pushed later edges since
+    if (this->in_frame_ && int32_t(now_us - this->last_us_) >= int32_t(this->idle_us_))
+      return this->close_(data);
+    return false;
+  }
+
+ protected:
+  bool edge_(uint32_t time_us, bool level, std::vector<int32_t> &data) {
+    if (level == this->last_level_)  // missed an edge, the current level goes on
+      return false;
+    const uint32_t duration = time_us - this->last_us_;
+    if (this->in_frame_ && duration < this->filter_us_ && (this->pushed_ || this->started_)) {
+      // glitch: the edge starting it is undone, the level before it goes on
+      if (this->pushed_) {
+        data.pop_back();
+      } else {
+        this->in_frame_ = false;
+      }
+      this->last_us_ = this->previous_us_;
+      this->last_level_ = level;
+      this->pushed_ = false;
+      this->started_ = false;
+      return false;
+    }
+    bool closed = false;
+    this->pushed_ = false;
+    this->started_ = false;
+    if (duration >= this->idle_us_) {
+      if (this->in_frame_)
+        closed = this->close_(data);
+      this->in_frame_ = level;  // a frame starts with a mark
+      if (level)
+        this->start_us_ = time_us;
+      this->started_ = level;
+    } else if (this->in_frame_) {
+      data.push_back(this->last_level_ ? int32_t(duration) : -int32_t(duration));
+      this->pushed_ = true;
+    }
+    this->previous_us_ = this->last_us_;
+    this->last_us_ = time_us;
+    this->last_level_ = level;
+    return closed;
+  }
+
+  bool close_(std::vector<int32_t> &data) {
+    this->in_frame_ = false;
+    this->first_us_ = this->start_us_;
+    this->close_us_ = micros();
+    if (data.empty())
+      return false;
+    if (!this->last_level_)
+      data.push_back(-int32_t(this->idle_us_));
+    return true;
+  }
+
+  uint32_t filter_us_;
+  uint32_t idle_us_;
+  uint32_t last_us_{0};
+  uint32_t previous_us_{0};  // edge before the last one, restored by a glitch
+  uint32_t start_us_{0};
+  uint32_t first_us_{0};
+  uint32_t close_us_{0};
+  bool last_level_{false};
+  bool in_frame_{false};
+  bool pushed_{false};   // the last edge ended a duration of data
+  bool started_{false};  // the last edge started the frame
+};
+
+}  // namespace remote_base
+}  // namespace esphome